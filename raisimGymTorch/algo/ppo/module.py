@@ -91,6 +91,21 @@ class MLP(nn.Module):
         self.input_shape = [input_size]
         self.output_shape = [output_size]
 
+    def export_weights(self, file_name):
+        """writes the layers for the native runtime (PolicyRuntime.hpp): a header of uint32 magic "RGPW", version,
+        layer count, activation (0: LeakyReLU) and float32 negative slope, then for every layer uint32 output and input
+        dims, float32 weights [output x input] (row-major) and float32 bias [output]"""
+        layers = [module for module in self.architecture if isinstance(module, nn.Linear)]
+        activation = next(module for module in self.architecture if not isinstance(module, nn.Linear))
+        assert isinstance(activation, nn.LeakyReLU), "the native runtime implements LeakyReLU only"
+        with open(file_name, 'wb') as file:
+            np.array([0x57504752, 1, len(layers), 0], dtype=np.uint32).tofile(file)
+            np.array([activation.negative_slope], dtype=np.float32).tofile(file)
+            for layer in layers:
+                np.array(layer.weight.shape, dtype=np.uint32).tofile(file)
+                layer.weight.detach().cpu().numpy().astype(np.float32).tofile(file)
+                layer.bias.detach().cpu().numpy().astype(np.float32).tofile(file)
+
     @staticmethod
     def init_weights(sequential, scales):
         [torch.nn.init.orthogonal_(module.weight, gain=scales[idx]) for idx, module in
@@ -27,12 +27,17 @@ class PPO:
                  use_clipped_value_loss=True,
                  log_dir='run',
                  device='cpu',
-                 shuffle_batch=True):
+                 shuffle_batch=True,
+                 share_critic_obs=False,
+                 obs_dtype='float32',
+                 actor_obs_scale=None,
+                 critic_obs_scale=None):
 
         # PPO components
         self.actor = actor
         self.critic = critic
-        self.storage = RolloutStorage(num_envs, num_transitions_per_env, actor.obs_shape, critic.obs_shape, actor.action_shape, device)
+        self.storage = RolloutStorage(num_envs, num_transitions_per_env, actor.obs_shape, critic.obs_shape, actor.action_shape, device,
+                                      share_critic_obs, obs_dtype, actor_obs_scale, critic_obs_scale)
 
         if shuffle_batch:
             self.batch_sampler = self.storage.mini_batch_generator_shuffle
@@ -79,9 +84,11 @@ class PPO:
             self.actions, self.actions_log_prob = self.actor.sample(torch.from_numpy(actor_obs).to(self.device))
         return self.actions
 
-    def step(self, value_obs, rews, dones):
-        self.storage.add_transitions(self.actor_obs, value_obs, self.actions, self.actor.action_mean, self.actor.distribution.std_np, rews, dones,
-                                     self.actions_log_prob)
+    def step(self, value_obs, rews, dones, actor_obs=None, truncated=None):
+        # actor_obs: the stored copy of the observation given to act(), e.g. its float16/int16 version
+        # truncated: the dones that are time limits, not failures. Their returns bootstrap from the value estimate
+        self.storage.add_transitions(self.actor_obs if actor_obs is None else actor_obs, value_obs, self.actions, self.actor.action_mean, self.actor.distribution.std_np, rews, dones,
+                                     self.actions_log_prob, truncated)
 
     def update(self, actor_obs, value_obs, log_this_iteration, update):
         last_values = self.critic.predict(torch.from_numpy(value_obs).to(self.device))
@@ -1,121 +1,156 @@
 import torch
-from torch.utils.data.sampler import BatchSampler, SubsetRandomSampler
 import numpy as np
 
 
 class RolloutStorage:
-    def __init__(self, num_envs, num_transitions_per_env, actor_obs_shape, critic_obs_shape, actions_shape, device):
+    def __init__(self, num_envs, num_transitions_per_env, actor_obs_shape, critic_obs_shape, actions_shape, device,
+                 share_critic_obs=False, obs_dtype='float32', actor_obs_scale=None, critic_obs_scale=None,
+                 chunk_size=64):
         self.device = device
+        # the critic observes the actor observation: one buffer serves both
+        self.share_critic_obs = share_critic_obs
+        # float16 or int16 observations (value = q * scale) halve the rollout and its copy to the device. They are
+        # converted to float32 on the device, one minibatch at a time
+        self.obs_dtype = np.dtype(obs_dtype)
+        assert self.obs_dtype in (np.float32, np.float16, np.int16), "observations are float32, float16 or int16"
+        if self.obs_dtype == np.int16:
+            assert actor_obs_scale is not None and critic_obs_scale is not None, "int16 observations need their scale"
+            self.actor_obs_scale = torch.from_numpy(np.asarray(actor_obs_scale, dtype=np.float32)).to(device)
+            self.critic_obs_scale = torch.from_numpy(np.asarray(critic_obs_scale, dtype=np.float32)).to(device)
+        # steps of the rollout whose values are predicted at once, so that only one chunk of the critic observation
+        # is converted to float32 at a time
+        self.chunk_size = chunk_size
 
         # Core
-        self.critic_obs = np.zeros([num_transitions_per_env, num_envs, *critic_obs_shape], dtype=np.float32)
-        self.actor_obs = np.zeros([num_transitions_per_env, num_envs, *actor_obs_shape], dtype=np.float32)
+        self.actor_obs = np.zeros([num_transitions_per_env, num_envs, *actor_obs_shape], dtype=self.obs_dtype)
+        if share_critic_obs:
+            assert tuple(critic_obs_shape) == tuple(actor_obs_shape), "a shared buffer needs identical observations"
+            self.critic_obs = self.actor_obs
+        else:
+            self.critic_obs = np.zeros([num_transitions_per_env, num_envs, *critic_obs_shape], dtype=self.obs_dtype)
         self.rewards = np.zeros([num_transitions_per_env, num_envs, 1], dtype=np.float32)
-        self.actions = np.zeros([num_transitions_per_env, num_envs, *actions_shape], dtype=np.float32)
-        self.dones = np.zeros([num_transitions_per_env, num_envs, 1], dtype=np.bool)
-
-        # For PPO
-        self.actions_log_prob = np.zeros([num_transitions_per_env, num_envs, 1], dtype=np.float32)
-        self.values = np.zeros([num_transitions_per_env, num_envs, 1], dtype=np.float32)
-        self.returns = np.zeros([num_transitions_per_env, num_envs, 1], dtype=np.float32)
-        self.advantages = np.zeros([num_transitions_per_env, num_envs, 1], dtype=np.float32)
-        self.mu = np.zeros([num_transitions_per_env, num_envs, *actions_shape], dtype=np.float32)
-        self.sigma = np.zeros([num_transitions_per_env, num_envs, *actions_shape], dtype=np.float32)
-
-        # torch variables
-        self.critic_obs_tc = torch.from_numpy(self.critic_obs).to(self.device)
-        self.actor_obs_tc = torch.from_numpy(self.actor_obs).to(self.device)
-        self.actions_tc = torch.from_numpy(self.actions).to(self.device)
-        self.actions_log_prob_tc = torch.from_numpy(self.actions_log_prob).to(self.device)
-        self.values_tc = torch.from_numpy(self.values).to(self.device)
-        self.returns_tc = torch.from_numpy(self.returns).to(self.device)
-        self.advantages_tc = torch.from_numpy(self.advantages).to(self.device)
-        self.mu_tc = torch.from_numpy(self.mu).to(self.device)
-        self.sigma_tc = torch.from_numpy(self.sigma).to(self.device)
+        self.dones = np.zeros([num_transitions_per_env, num_envs, 1], dtype=bool)
+        # episodes cut by a time limit rather than ended by a failure (a subset of dones)
+        self.truncated = np.zeros([num_transitions_per_env, num_envs, 1], dtype=bool)
+
+        # actions | sigma | mu | value | advantage | return | log prob of every transition, packed so that a minibatch
+        # of all of them is one gather or one slice. The fields are views of the packed buffer, and the torch tensors
+        # share it on the cpu, so every transition is held once
+        action_dim = int(np.prod(actions_shape))
+        self.transitions = np.zeros([num_transitions_per_env, num_envs, 3 * action_dim + 4], dtype=np.float32)
+        self.actions, self.sigma, self.mu, self.values, self.advantages, self.returns, self.actions_log_prob = \
+            np.split(self.transitions, np.cumsum([action_dim, action_dim, action_dim, 1, 1, 1]), axis=-1)
+
+        # torch variables, set by compute_returns
+        self.actor_obs_tc = None
+        self.critic_obs_tc = None
+        self.transitions_tc = None
 
         self.num_transitions_per_env = num_transitions_per_env
         self.num_envs = num_envs
-        self.device = device
+        # permuted copies of the observations and transitions, reused every epoch
+        self.shuffled = None
 
         self.step = 0
 
-    def add_transitions(self, actor_obs, critic_obs, actions, mu, sigma, rewards, dones, actions_log_prob):
+    def add_transitions(self, actor_obs, critic_obs, actions, mu, sigma, rewards, dones, actions_log_prob, truncated=None):
         if self.step >= self.num_transitions_per_env:
             raise AssertionError("Rollout buffer overflow")
-        self.critic_obs[self.step] = critic_obs
         self.actor_obs[self.step] = actor_obs
+        if not self.share_critic_obs:
+            self.critic_obs[self.step] = critic_obs
         self.actions[self.step] = actions
         self.mu[self.step] = mu
         self.sigma[self.step] = sigma
         self.rewards[self.step] = rewards.reshape(-1, 1)
         self.dones[self.step] = dones.reshape(-1, 1)
+        self.truncated[self.step] = False if truncated is None else truncated.reshape(-1, 1)
         self.actions_log_prob[self.step] = actions_log_prob.reshape(-1, 1)
         self.step += 1
 
     def clear(self):
         self.step = 0
 
+    def actor_obs_float(self, obs):
+        if self.obs_dtype == np.int16:
+            return obs.float() * self.actor_obs_scale
+        return obs.float()
+
+    def critic_obs_float(self, obs):
+        if self.obs_dtype == np.int16:
+            return obs.float() * self.critic_obs_scale
+        return obs.float()
+
     def compute_returns(self, last_values, critic, gamma, lam):
+        # on the cpu, the tensors share the numpy buffers
+        self.actor_obs_tc = torch.from_numpy(self.actor_obs).to(self.device)
+        self.critic_obs_tc = self.actor_obs_tc if self.share_critic_obs else torch.from_numpy(self.critic_obs).to(self.device)
+
         with torch.inference_mode():
-            self.values = critic.predict(torch.from_numpy(self.critic_obs).to(self.device)).cpu().numpy()
+            for begin in range(0, self.num_transitions_per_env, self.chunk_size):
+                end = min(begin + self.chunk_size, self.num_transitions_per_env)
+                self.values[begin:end] = critic.predict(self.critic_obs_float(self.critic_obs_tc[begin:end])).cpu().numpy()
 
-        advantage = 0
+        # GAE, backwards in time with one step of state. A truncated step bootstraps from the value of its own state:
+        # the observation after it already belongs to the next episode
+        advantage = np.zeros([self.num_envs, 1], dtype=np.float32)
+        next_values = last_values.cpu().numpy()
 
         for step in reversed(range(self.num_transitions_per_env)):
-            if step == self.num_transitions_per_env - 1:
-                next_values = last_values.cpu().numpy()
-                # next_is_not_terminal = 1.0 - self.dones[step].float()
-            else:
-                next_values = self.values[step + 1]
-                # next_is_not_terminal = 1.0 - self.dones[step+1].float()
+            rewards = self.rewards[step]
+            if self.truncated[step].any():
+                rewards = rewards + gamma * self.values[step] * self.truncated[step]
 
             next_is_not_terminal = 1.0 - self.dones[step]
-            delta = self.rewards[step] + next_is_not_terminal * gamma * next_values - self.values[step]
+            delta = rewards + next_is_not_terminal * gamma * next_values - self.values[step]
             advantage = delta + next_is_not_terminal * gamma * lam * advantage
             self.returns[step] = advantage + self.values[step]
+            next_values = self.values[step]
 
-        # Compute and normalize the advantages
-        self.advantages = self.returns - self.values
-        self.advantages = (self.advantages - self.advantages.mean()) / (self.advantages.std() + 1e-8)
+        # Compute and normalize the advantages, in place
+        np.subtract(self.returns, self.values, out=self.advantages)
+        mean, std = self.advantages.mean(), self.advantages.std()
+        self.advantages -= mean
+        self.advantages /= std + 1e-8
 
         # Convert to torch variables
-        self.critic_obs_tc = torch.from_numpy(self.critic_obs).to(self.device)
-        self.actor_obs_tc = torch.from_numpy(self.actor_obs).to(self.device)
-        self.actions_tc = torch.from_numpy(self.actions).to(self.device)
-        self.actions_log_prob_tc = torch.from_numpy(self.actions_log_prob).to(self.device)
-        self.values_tc = torch.from_numpy(self.values).to(self.device)
-        self.returns_tc = torch.from_numpy(self.returns).to(self.device)
-        self.advantages_tc = torch.from_numpy(self.advantages).to(self.device)
-        self.sigma_tc = torch.from_numpy(self.sigma).to(self.device)
-        self.mu_tc = torch.from_numpy(self.mu).to(self.device)
+        self.transitions_tc = torch.from_numpy(self.transitions).to(self.device).view(self.num_transitions_per_env * self.num_envs, -1)
+
+    def _split_transitions(self, transitions):
+        action_dim = self.actions.shape[-1]
+        return torch.split(transitions, [action_dim, action_dim, action_dim, 1, 1, 1, 1], dim=-1)
+
+    def _mini_batches(self, actor_obs, critic_obs, transitions, num_mini_batches):
+        mini_batch_size = actor_obs.size(0) // num_mini_batches
+        for batch_id in range(num_mini_batches):
+            batch = slice(batch_id * mini_batch_size, (batch_id + 1) * mini_batch_size)
+            actions_batch, sigma_batch, mu_batch, values_batch, advantages_batch, returns_batch, old_actions_log_prob_batch = \
+                self._split_transitions(transitions[batch])
+            yield self.actor_obs_float(actor_obs[batch]), self.critic_obs_float(critic_obs[batch]), actions_batch, sigma_batch, \
+                mu_batch, values_batch, advantages_batch, returns_batch, old_actions_log_prob_batch
 
     def mini_batch_generator_shuffle(self, num_mini_batches):
+        # one permutation per call (epoch): every field is gathered once into a permuted copy, and the minibatches are
+        # contiguous slices of it
         batch_size = self.num_envs * self.num_transitions_per_env
-        mini_batch_size = batch_size // num_mini_batches
-
-        for indices in BatchSampler(SubsetRandomSampler(range(batch_size)), mini_batch_size, drop_last=True):
-            actor_obs_batch = self.actor_obs_tc.view(-1, *self.actor_obs_tc.size()[2:])[indices]
-            critic_obs_batch = self.critic_obs_tc.view(-1, *self.critic_obs_tc.size()[2:])[indices]
-            actions_batch = self.actions_tc.view(-1, self.actions_tc.size(-1))[indices]
-            sigma_batch = self.sigma_tc.view(-1, self.sigma_tc.size(-1))[indices]
-            mu_batch = self.mu_tc.view(-1, self.mu_tc.size(-1))[indices]
-            values_batch = self.values_tc.view(-1, 1)[indices]
-            returns_batch = self.returns_tc.view(-1, 1)[indices]
-            old_actions_log_prob_batch = self.actions_log_prob_tc.view(-1, 1)[indices]
-            advantages_batch = self.advantages_tc.view(-1, 1)[indices]
-            yield actor_obs_batch, critic_obs_batch, actions_batch, sigma_batch, mu_batch, values_batch, advantages_batch, returns_batch, old_actions_log_prob_batch
+        permutation = torch.randperm(batch_size, device=self.device)
+        actor_obs = self.actor_obs_tc.view(batch_size, *self.actor_obs_tc.size()[2:])
+        critic_obs = self.critic_obs_tc.view(batch_size, *self.critic_obs_tc.size()[2:])
+
+        if self.shuffled is None:
+            self.shuffled = (torch.empty_like(actor_obs), None if self.share_critic_obs else torch.empty_like(critic_obs),
+                             torch.empty_like(self.transitions_tc))
+        shuffled_actor_obs, shuffled_critic_obs, shuffled_transitions = self.shuffled
+        torch.index_select(actor_obs, 0, permutation, out=shuffled_actor_obs)
+        if self.share_critic_obs:
+            shuffled_critic_obs = shuffled_actor_obs
+        else:
+            torch.index_select(critic_obs, 0, permutation, out=shuffled_critic_obs)
+        torch.index_select(self.transitions_tc, 0, permutation, out=shuffled_transitions)
+        yield from self._mini_batches(shuffled_actor_obs, shuffled_critic_obs, shuffled_transitions, num_mini_batches)
 
     def mini_batch_generator_inorder(self, num_mini_batches):
         batch_size = self.num_envs * self.num_transitions_per_env
-        mini_batch_size = batch_size // num_mini_batches
-
-        for batch_id in range(num_mini_batches):
-            yield self.actor_obs_tc.view(-1, *self.actor_obs_tc.size()[2:])[batch_id*mini_batch_size:(batch_id+1)*mini_batch_size], \
-                self.critic_obs_tc.view(-1, *self.critic_obs_tc.size()[2:])[batch_id*mini_batch_size:(batch_id+1)*mini_batch_size], \
-                self.actions_tc.view(-1, self.actions_tc.size(-1))[batch_id*mini_batch_size:(batch_id+1)*mini_batch_size], \
-                self.sigma_tc.view(-1, self.sigma_tc.size(-1))[batch_id*mini_batch_size:(batch_id+1)*mini_batch_size], \
-                self.mu_tc.view(-1, self.mu_tc.size(-1))[batch_id*mini_batch_size:(batch_id+1)*mini_batch_size], \
-                self.values_tc.view(-1, 1)[batch_id*mini_batch_size:(batch_id+1)*mini_batch_size], \
-                self.advantages_tc.view(-1, 1)[batch_id*mini_batch_size:(batch_id+1)*mini_batch_size], \
-                self.returns_tc.view(-1, 1)[batch_id*mini_batch_size:(batch_id+1)*mini_batch_size], \
-                self.actions_log_prob_tc.view(-1, 1)[batch_id*mini_batch_size:(batch_id+1)*mini_batch_size]
+        yield from self._mini_batches(self.actor_obs_tc.view(batch_size, *self.actor_obs_tc.size()[2:]),
+                                      self.critic_obs_tc.view(batch_size, *self.critic_obs_tc.size()[2:]),
+                                      self.transitions_tc, num_mini_batches)
@@ -0,0 +1,43 @@
+//----------------------------//
+// This file is part of RaiSim//
+// Copyright 2020, RaiSim Tech//
+//----------------------------//
+
+#ifndef SRC_RAISIMGYMAPPHELPER_HPP
+#define SRC_RAISIMGYMAPPHELPER_HPP
+
+#include <fstream>
+#include <string>
+
+namespace raisim {
+
+/// extracts the "environment:" block of a task cfg.yaml (the part runner.py dumps into the VectorizedEnvironment)
+inline std::string readEnvironmentConfig(const std::string& cfgFile) {
+  std::ifstream myfile (cfgFile);
+  RSFATAL_IF(!myfile.is_open(), "cannot open "<<cfgFile)
+  std::string config_str, line;
+  bool escape = false;
+
+  while (std::getline(myfile, line)) {
+    if(line == "environment:") {
+      escape = true;
+      while (std::getline(myfile, line)) {
+        if(line.substr(0, 2) == "  ")
+          config_str += line.substr(2) + "\n";
+        else if (line[0] == '#')
+          continue;
+        else
+          break;
+      }
+    }
+    if(escape)
+      break;
+  }
+  RSFATAL_IF(config_str.empty(), "no environment block in "<<cfgFile)
+  config_str.pop_back();
+  return config_str;
+}
+
+}
+
+#endif //SRC_RAISIMGYMAPPHELPER_HPP
@@ -11,7 +11,10 @@ using Dtype = float;
 using EigenRowMajorMat = Eigen::Matrix<Dtype, -1, -1, Eigen::RowMajor>;
 using EigenVec = Eigen::Matrix<Dtype, -1, 1>;
 using EigenBoolVec = Eigen::Matrix<bool, -1, 1>;
+using EigenIntVec = Eigen::Matrix<int, -1, 1>;
 using EigenDoubleVec = Eigen::Matrix<double, -1, 1>;
+using EigenDoubleRowMajorMat = Eigen::Matrix<double, -1, -1, Eigen::RowMajor>;
+using EigenInt16RowMajorMat = Eigen::Matrix<int16_t, -1, -1, Eigen::RowMajor>;
 
 #define __RSG_MAKE_STR(x) #x
 #define _RSG_MAKE_STR(x) __RSG_MAKE_STR(x)
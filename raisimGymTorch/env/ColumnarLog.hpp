@@ -0,0 +1,230 @@
+//----------------------------//
+// This file is part of RaiSim//
+// Copyright 2020, RaiSim Tech//
+//----------------------------//
+
+#ifndef SRC_RAISIMGYMCOLUMNARLOG_HPP
+#define SRC_RAISIMGYMCOLUMNARLOG_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace raisim {
+
+/// Per-step data of a set of environments in a columnar file, for offline analysis.
+/// Layout: Header, Column[columnCount], uint32 env ids[envCount], zero padding up to dataOffset, then the chunks.
+/// A chunk (chunkBytes) holds chunkSteps steps of every column: for each column, at Column.offset within the chunk,
+/// a block of [chunkSteps x envCount x width] values of its type, in the native byte order. Header.steps counts the
+/// steps written so far; the last chunk may be partly filled.
+/// Steps are written into a staging chunk. A full chunk is swapped with a second staging chunk and a background
+/// thread copies it into the memory-mapped file, so a step costs only the copy of its own rows. The step waits only
+/// if the previous chunk is still being written.
+class ColumnarLog {
+ public:
+  static constexpr uint32_t magic = 0x4c434752; /// "RGCL"
+  static constexpr uint32_t version = 1;
+  static constexpr uint64_t alignment = 4096; /// of dataOffset and chunkBytes, a multiple of the page size
+
+  enum Type : uint32_t { FLOAT32 = 0, FLOAT64, UINT8 };
+
+  struct Header {
+    uint32_t magic, version;
+    uint32_t columnCount, envCount;
+    uint32_t chunkSteps, reserved;
+    uint64_t dataOffset, chunkBytes;
+    uint64_t steps;
+  };
+
+  struct Column {
+    char name[48];
+    uint32_t type, width; /// values per environment and step
+    uint64_t offset; /// of the column block within a chunk
+  };
+
+  ColumnarLog() = default;
+  ColumnarLog(const ColumnarLog&) = delete;
+  ColumnarLog& operator=(const ColumnarLog&) = delete;
+  ~ColumnarLog() { stop(); }
+
+  static size_t typeSize(uint32_t type) { return type == FLOAT64 ? 8 : type == FLOAT32 ? 4 : 1; }
+
+  /// returns the index of the column. Columns are added before start()
+  int addColumn(const std::string &name, Type type, int width) {
+    RSFATAL_IF(logging(), "columns cannot be added while logging")
+    RSFATAL_IF(name.size() >= sizeof(Column::name), "column name "<<name<<" is too long")
+    Column column{};
+    std::strcpy(column.name, name.c_str());
+    column.type = type;
+    column.width = uint32_t(width);
+    columns_.push_back(column);
+    return int(columns_.size()) - 1;
+  }
+
+  void clearColumns() {
+    RSFATAL_IF(logging(), "columns cannot be removed while logging")
+    columns_.clear();
+  }
+
+  void start(const std::string &fileName, const std::vector<int> &envIds, int chunkSteps) {
+    stop();
+    RSFATAL_IF(columns_.empty(), "no columns to log")
+    RSFATAL_IF(envIds.empty(), "no environments to log")
+    RSFATAL_IF(chunkSteps <= 0, "chunk steps must be positive")
+
+    envCount_ = int(envIds.size());
+    chunkSteps_ = chunkSteps;
+    uint64_t offset = 0;
+    for (auto &column: columns_) {
+      column.offset = offset;
+      offset += roundUp(uint64_t(chunkSteps) * envCount_ * column.width * typeSize(column.type), 64);
+    }
+    header_ = Header{magic, version, uint32_t(columns_.size()), uint32_t(envCount_), uint32_t(chunkSteps), 0,
+                     roundUp(sizeof(Header) + sizeof(Column) * columns_.size() + sizeof(uint32_t) * envIds.size(), alignment),
+                     roundUp(offset, alignment), 0};
+    front_.assign(header_.chunkBytes, 0);
+    back_.assign(header_.chunkBytes, 0);
+    step_ = 0;
+    chunks_ = 0;
+    pending_ = 0;
+
+    std::vector<char> head(header_.dataOffset, 0);
+    std::memcpy(head.data(), &header_, sizeof(Header));
+    std::memcpy(head.data() + sizeof(Header), columns_.data(), sizeof(Column) * columns_.size());
+    std::vector<uint32_t> ids(envIds.begin(), envIds.end());
+    std::memcpy(head.data() + sizeof(Header) + sizeof(Column) * columns_.size(), ids.data(), sizeof(uint32_t) * ids.size());
+#if defined(__unix__) || defined(__APPLE__)
+    fd_ = ::open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    RSFATAL_IF(fd_ < 0, "cannot open "<<fileName)
+    RSFATAL_IF(::ftruncate(fd_, off_t(header_.dataOffset)) != 0, "cannot resize "<<fileName)
+    void *mapped = mmap(nullptr, header_.dataOffset, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    RSFATAL_IF(mapped == MAP_FAILED, "cannot map "<<fileName)
+    mappedHeader_ = static_cast<char *>(mapped);
+    std::memcpy(mappedHeader_, head.data(), head.size());
+#else
+    file_.open(fileName, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+    RSFATAL_IF(!file_.is_open(), "cannot open "<<fileName)
+    file_.write(head.data(), std::streamsize(head.size()));
+#endif
+    stop_ = false;
+    writer_ = std::thread(&ColumnarLog::writeLoop, this);
+  }
+
+  /// writes the steps in the staging chunk and closes the file
+  void stop() {
+    if (!writer_.joinable()) return;
+    if (step_ > 0) submit();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    writer_.join();
+#if defined(__unix__) || defined(__APPLE__)
+    munmap(mappedHeader_, header_.dataOffset);
+    mappedHeader_ = nullptr;
+    ::close(fd_);
+    fd_ = -1;
+#else
+    file_.seekp(0);
+    file_.write(reinterpret_cast<const char *>(&header_), sizeof(Header));
+    file_.close();
+#endif
+  }
+
+  [[nodiscard]] bool logging() const { return writer_.joinable(); }
+  [[nodiscard]] int envCount() const { return envCount_; }
+  [[nodiscard]] uint64_t steps() const { return chunks_ * uint64_t(chunkSteps_) + step_; }
+
+  /// the width values of column of environment slot (the index in envIds) in the current step
+  template<typename T>
+  T *row(int column, int slot) {
+    const auto &c = columns_[column];
+    return reinterpret_cast<T *>(front_.data() + c.offset) + (size_t(step_) * envCount_ + slot) * c.width;
+  }
+
+  /// closes the current step
+  void endStep() {
+    if (++step_ == chunkSteps_) submit();
+  }
+
+ private:
+  static uint64_t roundUp(uint64_t size, uint64_t multiple) { return (size + multiple - 1) / multiple * multiple; }
+
+  /// hands the staging chunk to the writer, once it has written the previous one
+  void submit() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&]() { return pending_ == 0; });
+    std::swap(front_, back_);
+    pending_ = step_;
+    step_ = 0;
+    chunks_++;
+    lock.unlock();
+    cv_.notify_all();
+  }
+
+  void writeLoop() {
+    uint64_t chunk = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      cv_.wait(lock, [&]() { return stop_ || pending_ > 0; });
+      if (pending_ == 0 && stop_) break;
+      const int steps = pending_;
+      lock.unlock();
+      writeChunk(chunk++, steps);
+      lock.lock();
+      pending_ = 0;
+      cv_.notify_all();
+    }
+  }
+
+  void writeChunk(uint64_t chunk, int steps) {
+    const uint64_t offset = header_.dataOffset + chunk * header_.chunkBytes;
+#if defined(__unix__) || defined(__APPLE__)
+    RSFATAL_IF(::ftruncate(fd_, off_t(offset + header_.chunkBytes)) != 0, "cannot grow the log file")
+    void *mapped = mmap(nullptr, header_.chunkBytes, PROT_WRITE, MAP_SHARED, fd_, off_t(offset));
+    RSFATAL_IF(mapped == MAP_FAILED, "cannot map the log file")
+    std::memcpy(mapped, back_.data(), header_.chunkBytes);
+    munmap(mapped, header_.chunkBytes);
+    header_.steps += steps;
+    reinterpret_cast<Header *>(mappedHeader_)->steps = header_.steps;
+#else
+    file_.seekp(std::streamoff(offset));
+    file_.write(back_.data(), std::streamsize(header_.chunkBytes));
+    header_.steps += steps;
+#endif
+  }
+
+  std::vector<Column> columns_;
+  Header header_{};
+  int envCount_ = 0, chunkSteps_ = 0;
+  int step_ = 0; /// in the staging chunk
+  uint64_t chunks_ = 0; /// submitted
+  std::vector<char> front_, back_;
+  int pending_ = 0; /// steps in back_ waiting for the writer
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread writer_;
+  bool stop_ = false;
+#if defined(__unix__) || defined(__APPLE__)
+  int fd_ = -1;
+  char *mappedHeader_ = nullptr;
+#else
+  std::fstream file_;
+#endif
+};
+
+}
+
+#endif //SRC_RAISIMGYMCOLUMNARLOG_HPP
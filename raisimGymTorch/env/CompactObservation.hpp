@@ -0,0 +1,74 @@
+//----------------------------//
+// This file is part of RaiSim//
+// Copyright 2020, RaiSim Tech//
+//----------------------------//
+
+#ifndef SRC_RAISIMGYMCOMPACTOBSERVATION_HPP
+#define SRC_RAISIMGYMCOMPACTOBSERVATION_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <Eigen/Core>
+#include "BasicEigenTypes.hpp"
+
+namespace raisim {
+
+/// 16-bit copies of the normalized observations for the rollout storage.
+/// float16: IEEE half precision bits (numpy views them as float16).
+/// int16: value = q * scale[dim], saturated at +-range. The observations are normalized to unit variance before
+/// they are quantized, so every dimension shares the scale range / 32767 and the default range of 8 keeps 8 standard
+/// deviations.
+/// quantize() replaces the observation with its 16-bit round trip, so the policy acts on exactly the values that
+/// the rollout storage recovers (including the saturation) and PPO's log-probabilities match the sampled actions.
+class CompactObservation {
+ public:
+  enum class Type { FLOAT32, FLOAT16, INT16 };
+
+  void init(int envs, int obDim, Type type, float range) {
+    type_ = type;
+    if (!enabled()) return;
+    buffer_.setZero(envs, obDim);
+    scale_.setConstant(obDim, type == Type::INT16 ? range / 32767.f : 1.f);
+    invScale_ = scale_.cwiseInverse();
+    range_ = range;
+  }
+
+  [[nodiscard]] bool enabled() const { return type_ != Type::FLOAT32; }
+  [[nodiscard]] Type type() const { return type_; }
+
+  void quantize(Eigen::Ref<EigenRowMajorMat> ob) {
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < int(ob.rows()); i++) {
+      if (type_ == Type::FLOAT16) {
+        for (int j = 0; j < int(ob.cols()); j++) {
+          const Eigen::half value(ob(i, j));
+          buffer_(i, j) = int16_t(Eigen::numext::bit_cast<uint16_t>(value));
+          ob(i, j) = float(value);
+        }
+      } else {
+        for (int j = 0; j < int(ob.cols()); j++) {
+          buffer_(i, j) = int16_t(std::lrint(std::clamp(ob(i, j), -range_, range_) * invScale_[j]));
+          ob(i, j) = float(buffer_(i, j)) * scale_[j];
+        }
+      }
+    }
+  }
+
+  /// [envs x obDim], row-major
+  [[nodiscard]] int16_t *data() { return buffer_.data(); }
+  [[nodiscard]] int envs() const { return int(buffer_.rows()); }
+  [[nodiscard]] int obDim() const { return int(buffer_.cols()); }
+  /// multiply int16 values by this to recover the observation
+  [[nodiscard]] const EigenVec &scale() const { return scale_; }
+
+ private:
+  Type type_ = Type::FLOAT32;
+  float range_ = 8.f;
+  EigenInt16RowMajorMat buffer_;
+  EigenVec scale_, invScale_;
+};
+
+}
+
+#endif //SRC_RAISIMGYMCOMPACTOBSERVATION_HPP
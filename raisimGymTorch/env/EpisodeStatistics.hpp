@@ -0,0 +1,144 @@
+//----------------------------//
+// This file is part of RaiSim//
+// Copyright 2020, RaiSim Tech//
+//----------------------------//
+
+#ifndef SRC_RAISIMGYMEPISODESTATISTICS_HPP
+#define SRC_RAISIMGYMEPISODESTATISTICS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <Eigen/Core>
+#include "BasicEigenTypes.hpp"
+
+namespace raisim {
+
+/// Running return, length and reward-term sums of the episode of every environment.
+/// When an episode ends, the thread that stepped it pushes a record into its own single-producer single-consumer ring,
+/// so recording takes no lock and never allocates. drain() is the only consumer; it may run while the asynchronous
+/// groups are being stepped. A record is a row [env, terminal, length, return, term sums...]. When a ring is full,
+/// new records are dropped and counted.
+class EpisodeStatistics {
+ public:
+  enum Column { ENV = 0, TERMINAL, LENGTH, RETURN, TERMS };
+
+  /// names of the columns of a record, given the names of the reward terms
+  static std::vector<std::string> columns(const std::vector<std::string> &terms) {
+    std::vector<std::string> names{"env", "terminal", "length", "return"};
+    names.insert(names.end(), terms.begin(), terms.end());
+    return names;
+  }
+
+  void init(int envs, int terms, int threads, int capacity) {
+    terms_ = terms;
+    return_.setZero(envs);
+    length_.assign(envs, 0);
+    termSums_.setZero(envs, terms);
+    rings_.clear();
+    for (int t = 0; t < threads; t++) {
+      rings_.emplace_back(new Ring);
+      rings_.back()->records.setZero(capacity, TERMS + terms);
+    }
+  }
+
+  /// one control step of env. Called by the thread that stepped it
+  template<typename Derived>
+  void accumulate(int thread, int env, float reward, bool terminal, const Eigen::MatrixBase<Derived> &terms) {
+    return_[env] += reward;
+    length_[env]++;
+    termSums_.row(env) += terms.transpose();
+    if (!terminal) return;
+
+    auto &ring = *rings_[thread];
+    const uint64_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) < uint64_t(ring.records.rows())) {
+      writeRecord(ring.records.row(int(head % ring.records.rows())), env, true);
+      ring.head.store(head + 1, std::memory_order_release);
+    } else {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+    restart(env);
+  }
+
+  /// the episodes in progress are discarded (all environments were reset)
+  void restart() {
+    return_.setZero();
+    std::fill(length_.begin(), length_.end(), 0);
+    termSums_.setZero();
+  }
+
+  /// the records of the finished episodes, at most maxRecords of them (the rest stays queued). With flush, the
+  /// episodes in progress are appended as records with terminal = 0 and restarted, so the returns of all records
+  /// sum to the rewards since the last flush. Flushing must not overlap with accumulate()
+  EigenDoubleRowMajorMat drain(bool flush, int maxRecords) {
+    int inProgress = 0;
+    if (flush)
+      for (int length: length_) inProgress += length > 0;
+    maxRecords = std::max(maxRecords - inProgress, 0);
+
+    std::vector<uint64_t> heads(rings_.size());
+    int count = 0;
+    for (size_t t = 0; t < rings_.size(); t++) {
+      heads[t] = rings_[t]->head.load(std::memory_order_acquire);
+      count += int(heads[t] - rings_[t]->tail.load(std::memory_order_relaxed));
+    }
+
+    EigenDoubleRowMajorMat records(std::min(count, maxRecords) + inProgress, TERMS + terms_);
+    int row = 0;
+    for (size_t t = 0; t < rings_.size(); t++) {
+      auto &ring = *rings_[t];
+      uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+      for (; tail < heads[t] && row < maxRecords; tail++)
+        records.row(row++) = ring.records.row(int(tail % ring.records.rows()));
+      ring.tail.store(tail, std::memory_order_release);
+    }
+
+    if (flush) {
+      for (int env = 0; env < int(length_.size()); env++) {
+        if (length_[env] == 0) continue;
+        writeRecord(records.row(row++), env, false);
+        restart(env);
+      }
+    }
+    return records;
+  }
+
+  [[nodiscard]] int termCount() const { return terms_; }
+  [[nodiscard]] uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+ private:
+  struct Ring {
+    alignas(64) std::atomic<uint64_t> head{0};
+    alignas(64) std::atomic<uint64_t> tail{0};
+    EigenDoubleRowMajorMat records;
+  };
+
+  template<typename Row>
+  void writeRecord(Row &&record, int env, bool terminal) {
+    record[ENV] = env;
+    record[TERMINAL] = terminal;
+    record[LENGTH] = length_[env];
+    record[RETURN] = return_[env];
+    record.tail(terms_) = termSums_.row(env);
+  }
+
+  void restart(int env) {
+    return_[env] = 0.;
+    length_[env] = 0;
+    termSums_.row(env).setZero();
+  }
+
+  int terms_ = 0;
+  EigenDoubleVec return_;
+  std::vector<int> length_;
+  EigenDoubleRowMajorMat termSums_;
+  std::vector<std::unique_ptr<Ring>> rings_;
+  std::atomic<uint64_t> dropped_{0};
+};
+
+}
+
+#endif //SRC_RAISIMGYMEPISODESTATISTICS_HPP
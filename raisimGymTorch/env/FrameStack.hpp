@@ -0,0 +1,72 @@
+//----------------------------//
+// This file is part of RaiSim//
+// Copyright 2020, RaiSim Tech//
+//----------------------------//
+
+#ifndef SRC_RAISIMGYMFRAMESTACK_HPP
+#define SRC_RAISIMGYMFRAMESTACK_HPP
+
+#include <algorithm>
+#include <vector>
+#include <Eigen/Core>
+#include "BasicEigenTypes.hpp"
+
+namespace raisim {
+
+/// The last `frames` observations of every environment, stacked without copies.
+/// Every environment owns 2 * frames slots of obDim floats and every frame is written twice, to slot head and
+/// head + frames. The last `frames` observations are then always the contiguous slots [window(), window() + frames),
+/// oldest first, and the same window for every environment (all environments are observed together), so the stack of
+/// all environments is one strided view of the buffer: buffer[:, window():window() + frames, :].
+/// After a reset, the first observation of the new episode fills the whole stack of that environment.
+class FrameStack {
+ public:
+  void init(int envs, int frames, int obDim) {
+    frames_ = frames;
+    obDim_ = obDim;
+    head_ = frames - 1;
+    buffer_.setZero(envs, 2 * frames * obDim);
+    episodeStart_.assign(envs, true);
+  }
+
+  [[nodiscard]] bool enabled() const { return frames_ > 0; }
+
+  /// appends one observation per environment. With advance = false, the newest frame is overwritten instead
+  /// (the environments were observed again without stepping)
+  void push(const Eigen::Ref<const EigenRowMajorMat> &ob, bool advance) {
+    if (advance) head_ = (head_ + 1) % frames_;
+#pragma omp parallel for schedule(static)
+    for (int e = 0; e < int(buffer_.rows()); e++) {
+      if (episodeStart_[e]) {
+        for (int slot = 0; slot < 2 * frames_; slot++)
+          buffer_.row(e).segment(slot * obDim_, obDim_) = ob.row(e);
+        episodeStart_[e] = false;
+      } else {
+        buffer_.row(e).segment(head_ * obDim_, obDim_) = ob.row(e);
+        buffer_.row(e).segment((head_ + frames_) * obDim_, obDim_) = ob.row(e);
+      }
+    }
+  }
+
+  /// the next observation of env starts a new episode
+  void markEpisodeStart(int env) { episodeStart_[env] = true; }
+  void markEpisodeStart() { std::fill(episodeStart_.begin(), episodeStart_.end(), true); }
+
+  /// first slot of the stack, oldest frame first
+  [[nodiscard]] int window() const { return head_ + 1; }
+  [[nodiscard]] int frames() const { return frames_; }
+  [[nodiscard]] int slots() const { return 2 * frames_; }
+  [[nodiscard]] int obDim() const { return obDim_; }
+  /// [envs x slots x obDim], row-major
+  [[nodiscard]] float *data() { return buffer_.data(); }
+  [[nodiscard]] int envs() const { return int(buffer_.rows()); }
+
+ private:
+  int frames_ = 0, obDim_ = 0, head_ = 0;
+  EigenRowMajorMat buffer_;
+  std::vector<char> episodeStart_;
+};
+
+}
+
+#endif //SRC_RAISIMGYMFRAMESTACK_HPP
@@ -0,0 +1,164 @@
+//----------------------------//
+// This file is part of RaiSim//
+// Copyright 2020, RaiSim Tech//
+//----------------------------//
+
+#ifndef SRC_RAISIMGYMMICROBENCHMARK_HPP
+#define SRC_RAISIMGYMMICROBENCHMARK_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace raisim {
+namespace microbench {
+
+/// number of heap allocations made so far. The benchmark executable increments it from its malloc
+inline std::atomic<size_t>& allocationCount() {
+  static std::atomic<size_t> count{0};
+  return count;
+}
+
+/// hardware cache-miss counter of the calling thread. Inactive (available() == false) if perf_event_open is not permitted
+class CacheMissCounter {
+ public:
+  CacheMissCounter() {
+#ifdef __linux__
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd_ = int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+  }
+
+  ~CacheMissCounter() {
+#ifdef __linux__
+    if (fd_ >= 0) close(fd_);
+#endif
+  }
+
+  CacheMissCounter(const CacheMissCounter&) = delete;
+  CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+  [[nodiscard]] bool available() const { return fd_ >= 0; }
+
+  void start() {
+#ifdef __linux__
+    if (fd_ < 0) return;
+    ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+  }
+
+  uint64_t stop() {
+    uint64_t count = 0;
+#ifdef __linux__
+    if (fd_ < 0) return 0;
+    ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd_, &count, sizeof(count)) != sizeof(count)) count = 0;
+#endif
+    return count;
+  }
+
+ private:
+  int fd_ = -1;
+};
+
+struct Result {
+  std::string name;
+  size_t iterations;
+  double nsPerCall, allocationsPerCall, cacheMissesPerCall;
+};
+
+/// Google Benchmark-style runner: the iteration count grows until one repetition takes minTime,
+/// then the median over the repetitions is reported per call
+class Runner {
+ public:
+  explicit Runner(double minTime = 0.1, int repetitions = 5, std::string filter = "") :
+      minTime_(minTime), repetitions_(repetitions), filter_(std::move(filter)) { }
+
+  void run(const std::string& name, const std::function<void()>& func) {
+    if (!filter_.empty() && name.find(filter_) == std::string::npos) return;
+
+    size_t iterations = 1;
+    while (runOnce(func, iterations).nsPerCall * double(iterations) < minTime_ * 1e9 && iterations < (size_t(1) << 30))
+      iterations *= 2;
+
+    std::vector<Result> repetitions;
+    for (int i = 0; i < repetitions_; i++)
+      repetitions.push_back(runOnce(func, iterations));
+    std::sort(repetitions.begin(), repetitions.end(), [](const Result& a, const Result& b) { return a.nsPerCall < b.nsPerCall; });
+
+    Result result = repetitions[repetitions.size() / 2];
+    result.name = name;
+    results_.push_back(result);
+    print(result);
+  }
+
+  void printHeader() const {
+    std::cout << std::left << std::setw(48) << "Benchmark" << std::right
+              << std::setw(14) << "Time(ns)" << std::setw(12) << "Iterations"
+              << std::setw(14) << "Allocs/call"
+              << std::setw(16) << (cacheMisses_.available() ? "CacheMiss/call" : "CacheMiss(n/a)") << "\n"
+              << std::string(104, '-') << std::endl;
+  }
+
+  [[nodiscard]] const std::vector<Result>& getResults() const { return results_; }
+
+ private:
+  Result runOnce(const std::function<void()>& func, size_t iterations) {
+    const size_t allocationsBefore = allocationCount().load(std::memory_order_relaxed);
+    cacheMisses_.start();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++)
+      func();
+    auto end = std::chrono::steady_clock::now();
+    const uint64_t misses = cacheMisses_.stop();
+    const size_t allocations = allocationCount().load(std::memory_order_relaxed) - allocationsBefore;
+
+    Result result;
+    result.iterations = iterations;
+    result.nsPerCall = std::chrono::duration<double, std::nano>(end - start).count() / double(iterations);
+    result.allocationsPerCall = double(allocations) / double(iterations);
+    result.cacheMissesPerCall = double(misses) / double(iterations);
+    return result;
+  }
+
+  void print(const Result& result) const {
+    std::cout << std::left << std::setw(48) << result.name << std::right << std::fixed
+              << std::setw(14) << std::setprecision(1) << result.nsPerCall
+              << std::setw(12) << result.iterations
+              << std::setw(14) << std::setprecision(2) << result.allocationsPerCall
+              << std::setw(16) << std::setprecision(2) << result.cacheMissesPerCall << std::endl;
+  }
+
+  double minTime_;
+  int repetitions_;
+  std::string filter_;
+  CacheMissCounter cacheMisses_;
+  std::vector<Result> results_;
+};
+
+}
+}
+
+#endif //SRC_RAISIMGYMMICROBENCHMARK_HPP
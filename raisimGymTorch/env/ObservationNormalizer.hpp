@@ -0,0 +1,132 @@
+//----------------------------//
+// This file is part of RaiSim//
+// Copyright 2020, RaiSim Tech//
+//----------------------------//
+
+#ifndef SRC_RAISIMGYMOBSERVATIONNORMALIZER_HPP
+#define SRC_RAISIMGYMOBSERVATIONNORMALIZER_HPP
+
+#include "omp.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <Eigen/Core>
+#include "BasicEigenTypes.hpp"
+#include "Profiler.hpp"
+
+namespace raisim {
+
+/// running mean and variance of the observation (parallel algorithm of Chan et al.), and the normalization
+/// (ob - mean) / sqrt(var + epsilon). The statistics are accumulated in double precision; the normalization uses
+/// float copies of them.
+/// Checkpoint layout (save/load), in the native byte order: uint32 magic, version, normalizer count, reserved, then
+/// for every normalizer uint32 obDim, reserved | double count | double mean[obDim] | double var[obDim]
+class ObservationNormalizer {
+ public:
+  static constexpr uint32_t magic = 0x4e534752; /// "RGNS"
+  static constexpr uint32_t version = 1;
+
+  void init(int obDim) {
+    meanAcc_.setZero(obDim);
+    varAcc_.setOnes(obDim);
+    recentMean_.setZero(obDim);
+    recentVar_.setZero(obDim);
+    delta_.setZero(obDim);
+    epsilon_.setConstant(obDim, 1e-8);
+    count_ = 1e-4;
+    updateNormalization();
+  }
+
+  void updateAndNormalize(Eigen::Ref<EigenRowMajorMat> &ob, bool updateStatistics) {
+    RSG_PROFILE_SCOPE(VEC_NORMALIZE)
+    const int rows = int(ob.rows());
+    if (updateStatistics) {
+      recentMean_.setZero();
+      for (int i = 0; i < rows; i++)
+        recentMean_ += ob.row(i).transpose().cast<double>();
+      recentMean_ /= rows;
+      recentVar_.setZero();
+      for (int i = 0; i < rows; i++)
+        recentVar_.array() += (ob.row(i).transpose().cast<double>() - recentMean_).array().square();
+      recentVar_ /= rows;
+
+      const double totCount = count_ + rows;
+      delta_ = meanAcc_ - recentMean_;
+      varAcc_ = (varAcc_ * count_ + recentVar_ * rows + delta_.cwiseAbs2() * (count_ * rows / totCount)) / totCount;
+      meanAcc_ = meanAcc_ * (count_ / totCount) + recentMean_ * (rows / totCount);
+      count_ = totCount;
+      updateNormalization();
+    }
+
+#pragma omp parallel for schedule(auto)
+    for(int i=0; i<rows; i++)
+      ob.row(i) = (ob.row(i) - mean_.transpose()).template cwiseQuotient((var_ + epsilon_).cwiseSqrt().transpose());
+  }
+
+  /// one observation, with the current statistics. Does not allocate
+  void normalize(Eigen::Ref<EigenVec> ob) const {
+    ob = (ob - mean_).cwiseQuotient((var_ + epsilon_).cwiseSqrt());
+  }
+
+  void getStatistics(Eigen::Ref<EigenVec> &mean, Eigen::Ref<EigenVec> &var, float &count) const {
+    mean = mean_; var = var_; count = float(count_); }
+  void setStatistics(Eigen::Ref<EigenVec> &mean, Eigen::Ref<EigenVec> &var, float count) {
+    meanAcc_ = mean.cast<double>(); varAcc_ = var.cast<double>(); count_ = count; updateNormalization(); }
+
+  [[nodiscard]] int obDim() const { return int(meanAcc_.size()); }
+
+  /// writes the accumulators of all normalizers, so that load() restores them exactly
+  static void save(const std::string &fileName, const std::vector<const ObservationNormalizer *> &normalizers) {
+    std::ofstream file(fileName, std::ios::binary);
+    RSFATAL_IF(!file.is_open(), "cannot open "<<fileName)
+    const uint32_t header[4] = {magic, version, uint32_t(normalizers.size()), 0};
+    file.write(reinterpret_cast<const char *>(header), sizeof(header));
+    for (auto *normalizer: normalizers) {
+      const uint32_t dims[2] = {uint32_t(normalizer->obDim()), 0};
+      file.write(reinterpret_cast<const char *>(dims), sizeof(dims));
+      file.write(reinterpret_cast<const char *>(&normalizer->count_), sizeof(double));
+      file.write(reinterpret_cast<const char *>(normalizer->meanAcc_.data()), std::streamsize(sizeof(double) * dims[0]));
+      file.write(reinterpret_cast<const char *>(normalizer->varAcc_.data()), std::streamsize(sizeof(double) * dims[0]));
+    }
+    RSFATAL_IF(!file.good(), "failed to write "<<fileName)
+  }
+
+  /// all normalizers of a checkpoint written by save()
+  static std::vector<ObservationNormalizer> load(const std::string &fileName) {
+    std::ifstream file(fileName, std::ios::binary);
+    RSFATAL_IF(!file.is_open(), "cannot open "<<fileName)
+    uint32_t header[4];
+    file.read(reinterpret_cast<char *>(header), sizeof(header));
+    RSFATAL_IF(!file || header[0] != magic, fileName<<" is not a normalization checkpoint")
+    RSFATAL_IF(header[1] != version, "normalization checkpoint version "<<header[1]<<" is not supported")
+    std::vector<ObservationNormalizer> normalizers(header[2]);
+    for (auto &normalizer: normalizers) {
+      uint32_t dims[2];
+      file.read(reinterpret_cast<char *>(dims), sizeof(dims));
+      normalizer.init(int(dims[0]));
+      file.read(reinterpret_cast<char *>(&normalizer.count_), sizeof(double));
+      file.read(reinterpret_cast<char *>(normalizer.meanAcc_.data()), std::streamsize(sizeof(double) * dims[0]));
+      file.read(reinterpret_cast<char *>(normalizer.varAcc_.data()), std::streamsize(sizeof(double) * dims[0]));
+      RSFATAL_IF(!file, "truncated normalization checkpoint "<<fileName)
+      normalizer.updateNormalization();
+    }
+    return normalizers;
+  }
+
+ private:
+  void updateNormalization() {
+    mean_ = meanAcc_.cast<float>();
+    var_ = varAcc_.cast<float>();
+  }
+
+  EigenVec mean_, var_; /// float copies of the accumulators
+  EigenDoubleVec meanAcc_, varAcc_;
+  double count_ = 1e-4;
+  EigenDoubleVec recentMean_, recentVar_, delta_;
+  EigenVec epsilon_;
+};
+
+}
+
+#endif //SRC_RAISIMGYMOBSERVATIONNORMALIZER_HPP
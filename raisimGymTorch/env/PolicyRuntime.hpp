@@ -0,0 +1,129 @@
+//----------------------------//
+// This file is part of RaiSim//
+// Copyright 2020, RaiSim Tech//
+//----------------------------//
+
+#ifndef SRC_RAISIMGYMPOLICYRUNTIME_HPP
+#define SRC_RAISIMGYMPOLICYRUNTIME_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <Eigen/Core>
+#include "BasicEigenTypes.hpp"
+#include "ObservationNormalizer.hpp"
+
+namespace raisim {
+
+/// The deterministic actor, as written by MLP.export_weights (module.py). Layout, in the native byte order:
+/// uint32 magic, version, layer count, activation (0: LeakyReLU) | float negative slope, then for every layer
+/// uint32 output dim, input dim | float weights[output x input] (row-major) | float bias[output].
+/// The activation follows every layer but the last. evaluate() works on preallocated buffers and does not allocate.
+class MlpPolicy {
+ public:
+  static constexpr uint32_t magic = 0x57504752; /// "RGPW"
+  static constexpr uint32_t version = 1;
+
+  void load(const std::string &fileName) {
+    std::ifstream file(fileName, std::ios::binary);
+    RSFATAL_IF(!file.is_open(), "cannot open "<<fileName)
+    uint32_t header[4];
+    file.read(reinterpret_cast<char *>(header), sizeof(header));
+    file.read(reinterpret_cast<char *>(&slope_), sizeof(slope_));
+    RSFATAL_IF(!file || header[0] != magic, fileName<<" is not an exported policy")
+    RSFATAL_IF(header[1] != version, "policy version "<<header[1]<<" is not supported")
+    RSFATAL_IF(header[3] != 0, "unknown activation "<<header[3]<<" in "<<fileName)
+
+    weights_.resize(header[2]);
+    biases_.resize(header[2]);
+    activations_.resize(header[2]);
+    for (uint32_t l = 0; l < header[2]; l++) {
+      uint32_t dims[2];
+      file.read(reinterpret_cast<char *>(dims), sizeof(dims));
+      RSFATAL_IF(l > 0 && dims[1] != uint32_t(weights_[l - 1].rows()), "layer "<<l<<" of "<<fileName<<" has "
+                 <<dims[1]<<" inputs, expected "<<weights_[l - 1].rows())
+      weights_[l].resize(dims[0], dims[1]);
+      biases_[l].resize(dims[0]);
+      activations_[l].setZero(dims[0]);
+      file.read(reinterpret_cast<char *>(weights_[l].data()), std::streamsize(sizeof(float) * weights_[l].size()));
+      file.read(reinterpret_cast<char *>(biases_[l].data()), std::streamsize(sizeof(float) * biases_[l].size()));
+    }
+    RSFATAL_IF(!file, "truncated policy file "<<fileName)
+  }
+
+  [[nodiscard]] bool loaded() const { return !weights_.empty(); }
+  [[nodiscard]] int inputDim() const { return int(weights_.front().cols()); }
+  [[nodiscard]] int outputDim() const { return int(weights_.back().rows()); }
+
+  /// the output stays valid until the next call
+  const EigenVec &evaluate(const Eigen::Ref<const EigenVec> &input) {
+    for (size_t l = 0; l < weights_.size(); l++) {
+      if (l == 0)
+        activations_[l].noalias() = weights_[l] * input;
+      else
+        activations_[l].noalias() = weights_[l] * activations_[l - 1];
+      activations_[l] += biases_[l];
+      if (l + 1 < weights_.size())
+        activations_[l] = activations_[l].cwiseMax(activations_[l] * slope_);
+    }
+    return activations_.back();
+  }
+
+ private:
+  std::vector<EigenRowMajorMat> weights_;
+  std::vector<EigenVec> biases_, activations_;
+  float slope_ = 0.01f;
+};
+
+/// reads a vector written by np.savetxt (one value per line)
+inline EigenVec loadCsvVector(const std::string &fileName) {
+  std::ifstream file(fileName);
+  RSFATAL_IF(!file.is_open(), "cannot open "<<fileName)
+  std::vector<float> values;
+  double value;
+  while (file >> value) values.push_back(float(value));
+  RSFATAL_IF(!file.eof(), "cannot parse "<<fileName)
+  return Eigen::Map<const EigenVec>(values.data(), Eigen::Index(values.size()));
+}
+
+/// the observation normalization of the trainer followed by the actor, for deployment without Python
+class PolicyRuntime {
+ public:
+  /// the actor and the text normalization of older training runs: actor_<it>.bin, mean<it>.csv and var<it>.csv
+  void load(const std::string &weightFile, const std::string &meanFile, const std::string &varFile) {
+    policy_.load(weightFile);
+    EigenVec mean = loadCsvVector(meanFile), var = loadCsvVector(varFile);
+    RSFATAL_IF(mean.size() != policy_.inputDim() || var.size() != policy_.inputDim(), "the normalization has "
+               <<mean.size()<<" dimensions, the policy takes "<<policy_.inputDim())
+    normalizer_.init(policy_.inputDim());
+    Eigen::Ref<EigenVec> meanRef(mean), varRef(var);
+    normalizer_.setStatistics(meanRef, varRef, 1.f);
+  }
+
+  /// the actor and the normalization checkpoint of the same iteration: actor_<it>.bin and scaling<it>.bin
+  void load(const std::string &weightFile, const std::string &scalingFile) {
+    policy_.load(weightFile);
+    auto normalizers = ObservationNormalizer::load(scalingFile);
+    RSFATAL_IF(normalizers.empty() || normalizers[0].obDim() != policy_.inputDim(), scalingFile
+               <<" does not hold the normalization of a "<<policy_.inputDim()<<"-dimensional observation")
+    normalizer_ = normalizers[0];
+  }
+
+  [[nodiscard]] int obDim() const { return policy_.inputDim(); }
+  [[nodiscard]] int actionDim() const { return policy_.outputDim(); }
+
+  /// normalizes ob in place and returns the action. Does not allocate
+  const EigenVec &act(Eigen::Ref<EigenVec> ob) {
+    normalizer_.normalize(ob);
+    return policy_.evaluate(ob);
+  }
+
+ private:
+  MlpPolicy policy_;
+  ObservationNormalizer normalizer_;
+};
+
+}
+
+#endif //SRC_RAISIMGYMPOLICYRUNTIME_HPP
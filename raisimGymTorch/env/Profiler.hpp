@@ -0,0 +1,213 @@
+//----------------------------//
+// This file is part of RaiSim//
+// Copyright 2020, RaiSim Tech//
+//----------------------------//
+
+#ifndef SRC_RAISIMGYMPROFILER_HPP
+#define SRC_RAISIMGYMPROFILER_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/// Per-phase scoped timers. They are compiled only if RAISIMGYM_PROFILE is defined (cmake -DRAISIMGYM_PROFILE=ON),
+/// otherwise RSG_PROFILE_SCOPE expands to nothing.
+/// Every thread writes to its own counters, so the hot path takes no lock. Only the first timer of a thread registers
+/// its counters (under a mutex). getProfile()/resetProfile() must not run concurrently with the timed code.
+#ifdef RAISIMGYM_PROFILE
+#define _RSG_PROFILE_CONCAT(a, b) a##b
+#define _RSG_PROFILE_NAME(a, b) _RSG_PROFILE_CONCAT(a, b)
+#define RSG_PROFILE_SCOPE(phase) raisim::profiler::ScopedTimer _RSG_PROFILE_NAME(rsgProfileTimer, __LINE__)(raisim::profiler::Phase::phase);
+/// a phase timed in several parts (e.g., a control step whose sub-steps are interleaved with those of other
+/// environments): the parts add up in the accumulator and RSG_PROFILE_COMMIT records the sum as one call
+#define RSG_PROFILE_ACCUMULATOR(name) uint64_t name = 0;
+#define RSG_PROFILE_PART(name) raisim::profiler::PartTimer _RSG_PROFILE_NAME(rsgProfilePart, __LINE__)(name);
+#define RSG_PROFILE_COMMIT(phase, name) raisim::profiler::commit(raisim::profiler::Phase::phase, name);
+#else
+#define RSG_PROFILE_SCOPE(phase)
+#define RSG_PROFILE_ACCUMULATOR(name)
+#define RSG_PROFILE_PART(name)
+#define RSG_PROFILE_COMMIT(phase, name)
+#endif
+
+namespace raisim {
+namespace profiler {
+
+enum class Phase : int {
+  VEC_STEP = 0,
+  VEC_OBSERVE,
+  VEC_NORMALIZE,
+  VEC_RESET,
+  VEC_CURRICULUM,
+  VEC_LOG,
+  ENV_STEP,
+  ENV_SUBSTEP,
+  ENV_PHYSICS,
+  ENV_STATE_UPDATE,
+  ENV_REWARD,
+  ENV_TERMINAL,
+  ENV_OBSERVE,
+  ENV_CRITIC_OBSERVE, /// the privileged part of the critic observation
+  ENV_RESET,
+  COUNT
+};
+
+inline const char* phaseName(Phase phase) {
+  static constexpr std::array<const char*, int(Phase::COUNT)> names = {
+      "vec.step", "vec.observe", "vec.normalize", "vec.reset", "vec.curriculum", "vec.log",
+      "env.step", "env.subStep", "env.physics", "env.stateUpdate", "env.reward", "env.terminal",
+      "env.observe", "env.criticObserve", "env.reset"};
+  return names[int(phase)];
+}
+
+inline uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+/// counters of one thread. The latest sampleCapacity durations of each phase are kept for the percentiles
+struct ThreadProfile {
+  static constexpr size_t sampleCapacity = 1024;
+
+  struct PhaseRecord {
+    uint64_t calls = 0, totalTicks = 0;
+    std::array<uint64_t, sampleCapacity> samples;
+  };
+
+  void add(Phase phase, uint64_t duration) {
+    auto& record = phases[int(phase)];
+    record.samples[record.calls % sampleCapacity] = duration;
+    record.calls++;
+    record.totalTicks += duration;
+  }
+
+  std::array<PhaseRecord, int(Phase::COUNT)> phases;
+};
+
+class Registry {
+ public:
+  static Registry& instance() {
+    static Registry registry;
+    return registry;
+  }
+
+  ThreadProfile* threadProfile() {
+    thread_local ThreadProfile* local = nullptr;
+    if (!local) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      profiles_.push_back(std::make_unique<ThreadProfile>());
+      local = profiles_.back().get();
+    }
+    return local;
+  }
+
+  /// phase -> {calls, total, p50, p99}. Times are in seconds
+  std::map<std::string, std::map<std::string, double>> aggregate() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const double secondsPerTick = calibrate();
+    std::map<std::string, std::map<std::string, double>> profile;
+
+    for (int p = 0; p < int(Phase::COUNT); p++) {
+      uint64_t calls = 0, totalTicks = 0;
+      std::vector<uint64_t> samples;
+      for (auto& threadProfile: profiles_) {
+        auto& record = threadProfile->phases[p];
+        calls += record.calls;
+        totalTicks += record.totalTicks;
+        samples.insert(samples.end(), record.samples.begin(),
+                       record.samples.begin() + std::min<uint64_t>(record.calls, ThreadProfile::sampleCapacity));
+      }
+      if (calls == 0) continue;
+
+      std::sort(samples.begin(), samples.end());
+      auto percentile = [&](double q) { return double(samples[size_t(q * double(samples.size() - 1))]) * secondsPerTick; };
+      profile[phaseName(Phase(p))] = {{"calls", double(calls)},
+                                      {"total", double(totalTicks) * secondsPerTick},
+                                      {"p50", percentile(0.5)},
+                                      {"p99", percentile(0.99)}};
+    }
+    return profile;
+  }
+
+  void reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& threadProfile: profiles_)
+      for (auto& record: threadProfile->phases) {
+        record.calls = 0;
+        record.totalTicks = 0;
+      }
+  }
+
+ private:
+  Registry() : startTime_(std::chrono::steady_clock::now()), startTicks_(ticks()) { }
+
+  /// the tick rate is measured against steady_clock over the lifetime of the registry
+  [[nodiscard]] double calibrate() const {
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime_).count();
+    const uint64_t elapsedTicks = ticks() - startTicks_;
+    return elapsedTicks > 0 ? seconds / double(elapsedTicks) : 0.;
+  }
+
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<ThreadProfile>> profiles_;
+  std::chrono::steady_clock::time_point startTime_;
+  uint64_t startTicks_;
+};
+
+class ScopedTimer {
+ public:
+  explicit ScopedTimer(Phase phase) : phase_(phase), start_(ticks()) { }
+  ~ScopedTimer() { Registry::instance().threadProfile()->add(phase_, ticks() - start_); }
+
+ private:
+  Phase phase_;
+  uint64_t start_;
+};
+
+class PartTimer {
+ public:
+  explicit PartTimer(uint64_t& accumulator) : accumulator_(accumulator), start_(ticks()) { }
+  ~PartTimer() { accumulator_ += ticks() - start_; }
+
+ private:
+  uint64_t& accumulator_;
+  uint64_t start_;
+};
+
+inline void commit(Phase phase, uint64_t& accumulator) {
+  Registry::instance().threadProfile()->add(phase, accumulator);
+  accumulator = 0;
+}
+
+inline std::map<std::string, std::map<std::string, double>> getProfile() {
+#ifdef RAISIMGYM_PROFILE
+  return Registry::instance().aggregate();
+#else
+  return {};
+#endif
+}
+
+inline void resetProfile() {
+#ifdef RAISIMGYM_PROFILE
+  Registry::instance().reset();
+#endif
+}
+
+}
+}
+
+#endif //SRC_RAISIMGYMPROFILER_HPP
@@ -20,14 +20,22 @@ class RaisimGymVecEnv:
         self.wrapper.init()
         self.num_obs = self.wrapper.getObDim()
         self.num_acts = self.wrapper.getActionDim()
+        self.num_critic_obs = self.wrapper.getCriticObDim()
+        self.separate_critic_obs = self.wrapper.hasSeparateCriticObservation()
+        self.compact_obs_type = self.wrapper.getCompactObservationType()
         self._observation = np.zeros([self.num_envs, self.num_obs], dtype=np.float32)
         self._reward = np.zeros(self.num_envs, dtype=np.float32)
         self._done = np.zeros(self.num_envs, dtype=np.bool)
-        self.rewards = [[] for _ in range(self.num_envs)]
         self.wrapper.setSeed(seed)
         self.count = 0.0
         self.mean = np.zeros(self.num_obs, dtype=np.float32)
         self.var = np.zeros(self.num_obs, dtype=np.float32)
+        self._frame_buffer = None
+        self._compact_buffers = None
+        if self.separate_critic_obs:
+            self._critic_observation = np.zeros([self.num_envs, self.num_critic_obs], dtype=np.float32)
+            self.critic_mean = np.zeros(self.num_critic_obs, dtype=np.float32)
+            self.critic_var = np.zeros(self.num_critic_obs, dtype=np.float32)
 
     def seed(self, seed=None):
         self.wrapper.setSeed(seed)
@@ -44,6 +52,26 @@ class RaisimGymVecEnv:
     def stop_video_recording(self):
         self.wrapper.stopRecordingVideo()
 
+    def start_trajectory_recording(self, file_name, env_id=0):
+        """records one environment to a binary trajectory file, without a RaisimServer. Play it back with the
+        <env>_replay executable or load it with helper.raisim_gym_helper.load_trajectory"""
+        self.wrapper.startRecordingTrajectory(file_name, env_id)
+
+    def stop_trajectory_recording(self, env_id=0):
+        """returns the number of records dropped because the disk could not keep up"""
+        return self.wrapper.stopRecordingTrajectory(env_id)
+
+    def start_logging(self, file_name, env_ids=None, chunk_steps=256):
+        """logs gc, gv, action, reward, done and foot contacts of env_ids (all by default) after every step to a
+        memory-mapped columnar file. Load it with helper.raisim_gym_helper.load_columnar_log"""
+        if env_ids is None:
+            env_ids = range(self.num_envs)
+        self.wrapper.startLogging(file_name, [int(i) for i in env_ids], chunk_steps)
+
+    def stop_logging(self):
+        """returns the number of logged steps"""
+        return self.wrapper.stopLogging()
+
     def step(self, action):
         self.wrapper.step(action, self._reward, self._done)
         return self._reward.copy(), self._done.copy()
@@ -52,25 +80,119 @@ class RaisimGymVecEnv:
         self.wrapper.step_visualize(action, self._reward, self._done)
         return self._reward.copy(), self._done.copy()
 
+    def async_reset(self):
+        """resets all environments for asynchronous stepping. Every group is then ready to be received"""
+        group_size = self.wrapper.getGroupSize(0)
+        self._async_observation = np.zeros([group_size, self.num_obs], dtype=np.float32)
+        self._async_reward = np.zeros(group_size, dtype=np.float32)
+        self._async_done = np.zeros(group_size, dtype=np.bool)
+        self._async_env_ids = np.zeros(group_size, dtype=np.int32)
+        self.wrapper.asyncReset()
+
+    def recv(self, update_statistics=True):
+        """waits for the next group stepped in the background. Returns (group, env_ids, obs, reward, done)"""
+        group = self.wrapper.recv(self._async_observation, self._async_reward, self._async_done,
+                                  self._async_env_ids, update_statistics)
+        n = self.wrapper.getGroupSize(group)
+        return group, self._async_env_ids[:n].copy(), self._async_observation[:n].copy(), \
+            self._async_reward[:n].copy(), self._async_done[:n].copy()
+
+    def send(self, group, action):
+        """steps a received group with action ([group size x action dim]) in the background and returns immediately"""
+        self.wrapper.send(group, action)
+
+    @property
+    def num_groups(self):
+        return self.wrapper.getNumOfGroups()
+
     def load_scaling(self, dir_name, iteration, count=1e5):
+        """restores the normalization saved by save_scaling. Runs that saved mean/var CSV files are read with count
+        as the sample count"""
+        scaling_file_name = dir_name + "/scaling" + str(iteration) + ".bin"
+        if os.path.exists(scaling_file_name):
+            has_critic_statistics = self.wrapper.loadObStatistics(scaling_file_name)
+            self.wrapper.getObStatistics(self.mean, self.var, self.count)
+            if self.separate_critic_obs:
+                if not has_critic_statistics:
+                    print("[RAISIM_GYM] warning: " + scaling_file_name + " has no critic statistics. The critic "
+                          "observation normalization starts from scratch")
+                self.wrapper.getCriticObStatistics(self.critic_mean, self.critic_var, self.count)
+            return
+
         mean_file_name = dir_name + "/mean" + str(iteration) + ".csv"
         var_file_name = dir_name + "/var" + str(iteration) + ".csv"
         self.count = count
         self.mean = np.loadtxt(mean_file_name, dtype=np.float32)
         self.var = np.loadtxt(var_file_name, dtype=np.float32)
         self.wrapper.setObStatistics(self.mean, self.var, self.count)
+        critic_mean_file_name = dir_name + "/critic_mean" + str(iteration) + ".csv"
+        if self.separate_critic_obs and os.path.exists(critic_mean_file_name):
+            self.critic_mean = np.loadtxt(critic_mean_file_name, dtype=np.float32)
+            self.critic_var = np.loadtxt(dir_name + "/critic_var" + str(iteration) + ".csv", dtype=np.float32)
+            self.wrapper.setCriticObStatistics(self.critic_mean, self.critic_var, self.count)
+        elif self.separate_critic_obs:
+            print("[RAISIM_GYM] warning: " + critic_mean_file_name + " does not exist. The critic observation "
+                  "normalization starts from scratch")
 
     def save_scaling(self, dir_name, iteration):
-        mean_file_name = dir_name + "/mean" + iteration + ".csv"
-        var_file_name = dir_name + "/var" + iteration + ".csv"
-        self.wrapper.getObStatistics(self.mean, self.var, self.count)
-        np.savetxt(mean_file_name, self.mean)
-        np.savetxt(var_file_name, self.var)
+        """writes the normalization statistics, with their double-precision accumulators, to scaling<iteration>.bin"""
+        self.wrapper.saveObStatistics(dir_name + "/scaling" + iteration + ".bin")
 
     def observe(self, update_statistics=True):
         self.wrapper.observe(self._observation, update_statistics)
         return self._observation
 
+    def observe_with_critic(self, update_statistics=True):
+        """(actor obs, critic obs). Without a privileged critic observation (critic_observation: actor), both are the
+        same array"""
+        if not self.separate_critic_obs:
+            obs = self.observe(update_statistics)
+            return obs, obs
+        self.wrapper.observeWithCritic(self._observation, self._critic_observation, update_statistics)
+        return self._observation, self._critic_observation
+
+    def get_compact_observation(self):
+        """(actor obs, critic obs) of the last observe()/observe_with_critic() in 16 bits (compact_observation.type
+        float16 or int16). The arrays are views of C++ buffers (no copy), valid until the next observe. int16 values
+        are multiplied by compact_obs_scale() to recover the observation"""
+        if self._compact_buffers is None:
+            actor = self.wrapper.getCompactObservationBuffer(False)
+            critic = self.wrapper.getCompactObservationBuffer(True) if self.separate_critic_obs else actor
+            if self.compact_obs_type == "float16":
+                actor, critic = actor.view(np.float16), critic.view(np.float16)
+            self._compact_buffers = (actor, critic)
+        return self._compact_buffers
+
+    def compact_obs_scale(self):
+        """per-dimension scale of the int16 (actor obs, critic obs)"""
+        actor = np.zeros(self.num_obs, dtype=np.float32)
+        self.wrapper.getCompactObScale(actor)
+        if not self.separate_critic_obs:
+            return actor, actor
+        critic = np.zeros(self.num_critic_obs, dtype=np.float32)
+        self.wrapper.getCompactCriticObScale(critic)
+        return actor, critic
+
+    def get_episode_stats(self, flush=False):
+        """the episodes finished since the last call, as a dict of arrays: env, terminal, length, return and the sum of
+        every reward term over the episode. With flush, the episodes in progress are also returned (terminal = 0) and
+        restart their sums, so that the returns add up to all rewards since the last flush"""
+        records = self.wrapper.getEpisodeStats(flush)
+        return {tag: records[:, i] for i, tag in enumerate(self.wrapper.getEpisodeStatsTag())}
+
+    def get_dropped_episode_count(self):
+        """the number of finished episodes dropped so far because a queue of episode_statistics.capacity was full.
+        Their rewards are missing from get_episode_stats()"""
+        return self.wrapper.getDroppedEpisodeCount()
+
+    def get_frame_stack(self):
+        """[num_envs x frame_stack.frames x obs dim] view of the last observations returned by observe(), oldest first.
+        The view shares the C++ ring buffer (no copy) and is only valid until the next observe()"""
+        if self._frame_buffer is None:
+            self._frame_buffer = self.wrapper.getFrameStackBuffer()
+        start = self.wrapper.getFrameStackWindow()
+        return self._frame_buffer[:, start:start + self._frame_buffer.shape[1] // 2]
+
     def reset(self):
         self._reward = np.zeros(self.num_envs, dtype=np.float32)
         self.wrapper.reset()
@@ -96,6 +218,41 @@ class RaisimGymVecEnv:
     def get_state(self, gc, gv):
         self.wrapper.getState(gc, gv)
 
+    def get_states(self, gc, gv):
+        """fills gc [num_envs x gc dim] and gv [num_envs x gv dim] of all environments in place. The arrays must be
+        C-contiguous float64 (e.g. np.zeros([env.num_envs, env.wrapper.getGcDim()])) to be written without a copy"""
+        self.wrapper.getStates(gc, gv)
+
+    def set_states(self, gc, gv):
+        """moves the robots of all environments to the rows of gc and gv"""
+        self.wrapper.setStates(gc, gv)
+
+    def get_profile(self):
+        return self.wrapper.getProfile()
+
+    def reset_profile(self):
+        self.wrapper.resetProfile()
+
+    def get_placement_report(self):
+        return self.wrapper.getPlacementReport()
+
+    def start_tracing(self, events_per_thread=1 << 16):
+        self.wrapper.startTracing(events_per_thread)
+
+    def stop_tracing(self):
+        self.wrapper.stopTracing()
+
+    def dump_trace(self, file_name):
+        self.wrapper.dumpTrace(file_name)
+
+    def get_snapshots(self):
+        """list of bytes, one binary snapshot per environment"""
+        return self.wrapper.getSnapshots()
+
+    def set_snapshots(self, snapshots):
+        """restores one snapshot per environment, or broadcasts a single snapshot to all environments"""
+        self.wrapper.setSnapshots(snapshots)
+
     @property
     def num_envs(self):
         return self.wrapper.getNumOfEnvs()
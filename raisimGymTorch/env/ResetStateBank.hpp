@@ -0,0 +1,144 @@
+//----------------------------//
+// This file is part of RaiSim//
+// Copyright 2020, RaiSim Tech//
+//----------------------------//
+
+#ifndef SRC_RAISIMGYMRESETSTATEBANK_HPP
+#define SRC_RAISIMGYMRESETSTATEBANK_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <Eigen/Core>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace raisim {
+
+/// Binary file of precomputed initial states, one section per terrain family (ground type).
+/// Layout: Header, Section[sectionCount], then the records of every section. A record is
+/// recordDim() doubles: gc | gv (at curriculum factor 1) | command | foot positions relative to the base (3 per foot).
+/// The file is memory-mapped read-only, so environments (and processes) opening the same bank share its pages.
+/// Values are stored in the native byte order.
+class ResetStateBank {
+ public:
+  static constexpr uint32_t magic = 0x42524752; /// "RGRB"
+  static constexpr uint32_t version = 1;
+
+  struct Header {
+    uint32_t magic, version;
+    uint32_t gcDim, gvDim, commandDim, footCount;
+    uint32_t sectionCount, reserved;
+  };
+
+  struct Section {
+    uint64_t offset; /// in bytes from the beginning of the file
+    uint64_t count;
+  };
+
+  ResetStateBank() = default;
+  ResetStateBank(const ResetStateBank&) = delete;
+  ResetStateBank& operator=(const ResetStateBank&) = delete;
+  ~ResetStateBank() { close(); }
+
+  /// sections[s] holds one record per column
+  static void save(const std::string& fileName, const Header& layout, const std::vector<Eigen::MatrixXd>& sections) {
+    Header header = layout;
+    header.magic = magic;
+    header.version = version;
+    header.sectionCount = uint32_t(sections.size());
+    header.reserved = 0;
+
+    std::vector<Section> table(sections.size());
+    uint64_t offset = sizeof(Header) + sizeof(Section) * sections.size();
+    for (size_t s = 0; s < sections.size(); s++) {
+      RSFATAL_IF(sections[s].rows() != recordDim(header), "section "<<s<<" has "<<sections[s].rows()<<" rows, expected "<<recordDim(header))
+      table[s] = {offset, uint64_t(sections[s].cols())};
+      offset += sizeof(double) * sections[s].size();
+    }
+
+    std::ofstream file(fileName, std::ios::binary);
+    RSFATAL_IF(!file.is_open(), "cannot open "<<fileName)
+    file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    file.write(reinterpret_cast<const char*>(table.data()), std::streamsize(sizeof(Section) * table.size()));
+    for (auto& section: sections)
+      file.write(reinterpret_cast<const char*>(section.data()), std::streamsize(sizeof(double) * section.size()));
+    RSFATAL_IF(!file.good(), "failed to write "<<fileName)
+  }
+
+  void open(const std::string& fileName) {
+    close();
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    RSFATAL_IF(fd < 0, "cannot open the reset state bank "<<fileName)
+    struct stat st;
+    fstat(fd, &st);
+    size_ = size_t(st.st_size);
+    void* mapped = size_ > 0 ? mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    RSFATAL_IF(mapped == MAP_FAILED, "cannot map the reset state bank "<<fileName)
+    data_ = static_cast<const char*>(mapped);
+#else
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    RSFATAL_IF(!file.is_open(), "cannot open the reset state bank "<<fileName)
+    fallback_.resize(size_t(file.tellg()));
+    file.seekg(0);
+    file.read(fallback_.data(), std::streamsize(fallback_.size()));
+    size_ = fallback_.size();
+    data_ = fallback_.data();
+#endif
+    RSFATAL_IF(size_ < sizeof(Header), fileName<<" is not a reset state bank")
+    std::memcpy(&header_, data_, sizeof(Header));
+    RSFATAL_IF(header_.magic != magic, fileName<<" is not a reset state bank")
+    RSFATAL_IF(header_.version != version, "reset state bank version "<<header_.version<<" is not supported")
+    RSFATAL_IF(size_ < sizeof(Header) + sizeof(Section) * header_.sectionCount, "truncated reset state bank")
+    sections_.resize(header_.sectionCount);
+    std::memcpy(sections_.data(), data_ + sizeof(Header), sizeof(Section) * sections_.size());
+    for (auto& section: sections_)
+      RSFATAL_IF(section.offset + sizeof(double) * recordDim() * section.count > size_, "truncated reset state bank")
+  }
+
+  void close() {
+#if defined(__unix__) || defined(__APPLE__)
+    if (data_) munmap(const_cast<char*>(data_), size_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    sections_.clear();
+  }
+
+  [[nodiscard]] bool loaded() const { return data_ != nullptr; }
+  [[nodiscard]] const Header& header() const { return header_; }
+  [[nodiscard]] int sectionCount() const { return int(sections_.size()); }
+  [[nodiscard]] size_t count(int section) const { return sections_[section].count; }
+  [[nodiscard]] int recordDim() const { return recordDim(header_); }
+
+  /// pointer to the recordDim() doubles of a record
+  [[nodiscard]] const double* record(int section, size_t index) const {
+    return reinterpret_cast<const double*>(data_ + sections_[section].offset) + index * recordDim();
+  }
+
+  static int recordDim(const Header& header) {
+    return int(header.gcDim + header.gvDim + header.commandDim + 3 * header.footCount);
+  }
+
+ private:
+  Header header_{};
+  std::vector<Section> sections_;
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+#if !(defined(__unix__) || defined(__APPLE__))
+  std::vector<char> fallback_;
+#endif
+};
+
+}
+
+#endif //SRC_RAISIMGYMRESETSTATEBANK_HPP
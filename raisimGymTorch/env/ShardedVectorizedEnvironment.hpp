@@ -0,0 +1,589 @@
+//----------------------------//
+// This file is part of RaiSim//
+// Copyright 2020, RaiSim Tech//
+//----------------------------//
+
+#ifndef SRC_RAISIMGYMSHARDEDVECENV_HPP
+#define SRC_RAISIMGYMSHARDEDVECENV_HPP
+
+#ifdef __linux__
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include "VectorizedEnvironment.hpp"
+
+extern char **environ;
+
+namespace raisim {
+
+/// Steps the environments in K worker processes (shards), each running a VectorizedEnvironment over a contiguous
+/// range of environments with its own OpenMP pool. This sidesteps contention inside one process (allocator, raisim
+/// globals, the single OpenMP team) and isolates crashes: a dead worker raises an error in the trainer instead of
+/// killing it.
+///
+/// Actions, observations, rewards, dones and step data live in one POSIX shared memory segment, so a step moves no
+/// data through pipes. Every shard has a control channel with a request and a response sequence word; the trainer
+/// bumps the request word and wakes the worker with a futex, the worker runs the command on its range and bumps the
+/// response word. All shards run a command concurrently.
+///
+/// Workers are started with posix_spawn from the shard worker executable (shard_worker.cpp) rather than forked, since
+/// the trainer process may already run an OpenMP pool, which does not survive a fork. The observation normalization
+/// runs in the trainer on the gathered batch, so the statistics are identical to the unsharded environment.
+template<class ChildEnvironment>
+class ShardedVectorizedEnvironment {
+ public:
+  enum Command : int32_t {
+    INIT = 0, STEP, STEP_VISUALIZE, OBSERVE, RESET, CURRICULUM, SET_SEED, GET_STEP_DATA, GET_EPISODE_STATS, IS_TERMINAL,
+    GET_STATE, SET_COMMAND, MOVE_CURSOR, TURN_ON_VISUALIZATION, TURN_OFF_VISUALIZATION, START_RECORDING, STOP_RECORDING,
+    START_TRAJECTORY, STOP_TRAJECTORY, SET_SIMULATION_DT, SET_CONTROL_DT, CLOSE, EXIT
+  };
+
+  static constexpr uint32_t magic = 0x44485352; /// "RSHD"
+  static constexpr int maxStepDataDim = 64;
+  static constexpr int maxStateDim = 256;
+  static constexpr int maxEpisodeRecords = 1024; /// finished episodes a shard returns per getEpisodeStats call
+  static constexpr int textSize = 4096;
+
+  /// one per shard, on its own cache lines
+  struct alignas(64) Channel {
+    std::atomic<uint32_t> request;
+    alignas(64) std::atomic<uint32_t> response;
+    int32_t command, intArg;
+    double doubleArg;
+    int32_t status; /// 0 if the last command succeeded, otherwise text holds the error
+    int32_t envOffset, envCount;
+    uint64_t cfgOffset, cfgSize;
+    char text[textSize];
+  };
+
+  /// at the beginning of the segment. Offsets are in bytes from the beginning of the segment
+  struct Header {
+    uint32_t magic;
+    int32_t shardCount, numEnvs, obDim, actionDim;
+    uint64_t channelOffset, actionOffset, obOffset, rewardOffset, doneOffset, stepDataOffset, stateOffset,
+        episodeOffset;
+  };
+
+  /// workerExecutable: the ${env}_shard_worker executable built next to the python module
+  ShardedVectorizedEnvironment(std::string resourceDir, std::string cfg, std::string workerExecutable)
+      : resourceDir_(std::move(resourceDir)), cfgString_(std::move(cfg)), workerExecutable_(std::move(workerExecutable)) {
+    Yaml::Parse(cfg_, cfgString_);
+  }
+
+  ~ShardedVectorizedEnvironment() {
+    for (int s = 0; s < int(pids_.size()); s++) {
+      if (pids_[s] <= 0) continue;
+      channel(s).command = EXIT;
+      post(s);
+    }
+    for (auto pid: pids_)
+      if (pid > 0) waitpid(pid, nullptr, 0);
+    if (segment_) munmap(segment_, segmentSize_);
+  }
+
+  ShardedVectorizedEnvironment(const ShardedVectorizedEnvironment&) = delete;
+  ShardedVectorizedEnvironment& operator=(const ShardedVectorizedEnvironment&) = delete;
+
+  void init() {
+    num_envs_ = cfg_["num_envs"].template As<int>();
+    const int shards = cfg_["num_shards"].template As<int>(1);
+    const int threads = cfg_["num_threads"].template As<int>();
+    RSFATAL_IF(shards < 1 || shards > num_envs_, "num_shards must be in [1, num_envs], got "<<shards)
+    RSFATAL_IF(cfg_["critic_observation"].template As<std::string>("actor") != "actor",
+               "sharded environments support critic_observation: actor only")
+    RSFATAL_IF(cfg_["compact_observation"]["type"].template As<std::string>("float32") != "float32",
+               "sharded environments support compact_observation.type: float32 only")
+    int startSeed;
+    READ_YAML(int, startSeed, cfg_["seed"])
+
+    /// contiguous ranges whose sizes differ by at most one. Environment ids, seeds and ground types match the
+    /// unsharded environment
+    std::vector<std::string> shardCfg(shards);
+    for (int s = 0, offset = 0; s < shards; s++) {
+      const int count = num_envs_ / shards + (s < num_envs_ % shards);
+      envOffset_.push_back(offset);
+      envCount_.push_back(count);
+      Yaml::Node node;
+      Yaml::Parse(node, cfgString_);
+      node["num_envs"] = std::to_string(count);
+      node["num_threads"] = std::to_string(std::max(1, threads / shards));
+      node["env_id_offset"] = std::to_string(offset);
+      node["seed"] = std::to_string(startSeed + offset);
+      if (s > 0) node["render"] = "False";
+      Yaml::Serialize(node, shardCfg[s]);
+      offset += count;
+    }
+
+    /// segment layout
+    const int obDim = ChildEnvironment::getObDim(), actionDim = ChildEnvironment::getActionDim();
+    auto align = [](uint64_t offset) { return (offset + 63) & ~uint64_t(63); };
+    Header header{};
+    header.magic = magic;
+    header.shardCount = shards;
+    header.numEnvs = num_envs_;
+    header.obDim = obDim;
+    header.actionDim = actionDim;
+    header.channelOffset = align(sizeof(Header));
+    header.actionOffset = align(header.channelOffset + sizeof(Channel) * shards);
+    header.obOffset = align(header.actionOffset + sizeof(float) * num_envs_ * actionDim);
+    header.rewardOffset = align(header.obOffset + sizeof(float) * num_envs_ * obDim);
+    header.doneOffset = align(header.rewardOffset + sizeof(float) * num_envs_);
+    header.stepDataOffset = align(header.doneOffset + sizeof(bool) * num_envs_);
+    header.stateOffset = align(header.stepDataOffset + sizeof(double) * num_envs_ * maxStepDataDim);
+    header.episodeOffset = align(header.stateOffset + sizeof(float) * 2 * maxStateDim);
+    uint64_t cfgOffset = align(header.episodeOffset + sizeof(double) * (shards * maxEpisodeRecords + num_envs_) *
+                                                      (EpisodeStatistics::TERMS + maxStepDataDim));
+    segmentSize_ = cfgOffset;
+    for (auto &text: shardCfg)
+      segmentSize_ = align(segmentSize_ + text.size());
+
+    /// the name is unlinked when init returns (or fails), once every worker mapped the segment, so nothing is left
+    /// behind if a process dies
+    static std::atomic<int> counter{0};
+    const std::string name = "/rsg_shard_" + std::to_string(getpid()) + "_" + std::to_string(counter++);
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    RSFATAL_IF(fd < 0, "cannot create the shared memory segment "<<name)
+    struct Unlink {
+      const std::string &name;
+      ~Unlink() { shm_unlink(name.c_str()); }
+    } unlink{name};
+    const bool sized = ftruncate(fd, off_t(segmentSize_)) == 0;
+    void *mapped = sized ? mmap(nullptr, segmentSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    RSFATAL_IF(mapped == MAP_FAILED, "cannot map the shared memory segment "<<name)
+    segment_ = static_cast<char *>(mapped);
+    std::memcpy(segment_, &header, sizeof(Header));
+    header_ = reinterpret_cast<Header *>(segment_);
+
+    for (int s = 0; s < shards; s++) {
+      Channel *ch = new(segment_ + header.channelOffset + sizeof(Channel) * s) Channel();
+      ch->request.store(0);
+      ch->response.store(0);
+      ch->envOffset = envOffset_[s];
+      ch->envCount = envCount_[s];
+      ch->cfgOffset = cfgOffset;
+      ch->cfgSize = shardCfg[s].size();
+      std::memcpy(segment_ + cfgOffset, shardCfg[s].data(), shardCfg[s].size());
+      cfgOffset = align(cfgOffset + shardCfg[s].size());
+    }
+
+    const std::string parent = std::to_string(getpid());
+    pids_.assign(shards, -1);
+    for (int s = 0; s < shards; s++) {
+      const std::string shard = std::to_string(s);
+      std::vector<char *> argv{const_cast<char *>(workerExecutable_.c_str()), const_cast<char *>(resourceDir_.c_str()),
+                               const_cast<char *>(name.c_str()), const_cast<char *>(shard.c_str()),
+                               const_cast<char *>(parent.c_str()), nullptr};
+      pid_t pid;
+      const int error = posix_spawn(&pid, workerExecutable_.c_str(), nullptr, nullptr, argv.data(), environ);
+      RSFATAL_IF(error != 0, "cannot start the shard worker "<<workerExecutable_<<": "<<std::strerror(error))
+      pids_[s] = pid;
+    }
+
+    /// INIT maps the segment and builds the shard's environments
+    runOnAll(INIT);
+
+    stepDataTag_.clear();
+    std::string tags(channel(0).text), tag;
+    for (char c: tags) {
+      if (c == '\n') { stepDataTag_.push_back(tag); tag.clear(); }
+      else tag += c;
+    }
+    stepDataRows_.resize(num_envs_, stepDataTag_.size());
+    obNormalizer_.init(obDim);
+  }
+
+  void reset() {
+    RSG_PROFILE_SCOPE(VEC_RESET)
+    runOnAll(RESET);
+  }
+
+  void observe(Eigen::Ref<EigenRowMajorMat> &ob, bool updateStatistics=false) {
+    runOnAll(OBSERVE);
+    {
+      RSG_PROFILE_SCOPE(VEC_OBSERVE)
+      ob = observations();
+    }
+    obNormalizer_.updateAndNormalize(ob, updateStatistics);
+  }
+
+  std::vector<std::string> getStepDataTag() { return stepDataTag_; }
+
+  int getStepData(int sample_size,
+                  Eigen::Ref<EigenDoubleVec> &mean,
+                  Eigen::Ref<EigenDoubleVec> &squareSum,
+                  Eigen::Ref<EigenDoubleVec> &min,
+                  Eigen::Ref<EigenDoubleVec> &max) {
+    if (stepDataTag_.empty()) return sample_size;
+    runOnAll(GET_STEP_DATA);
+    stepDataRows_ = Eigen::Map<EigenDoubleRowMajorMat>(
+        reinterpret_cast<double *>(segment_ + header_->stepDataOffset), num_envs_, stepDataTag_.size());
+    return VectorizedEnvironment<ChildEnvironment>::accumulateStepData(stepDataRows_, sample_size, mean, squareSum, min, max);
+  }
+
+  /// as VectorizedEnvironment::getEpisodeStats. Every shard returns at most maxEpisodeRecords finished episodes per
+  /// call; the rest stays queued in the shard
+  EigenDoubleRowMajorMat getEpisodeStats(bool flush=false) {
+    runOnAll(GET_EPISODE_STATS, flush);
+    const int width = EpisodeStatistics::TERMS + int(stepDataTag_.size());
+    int rows = 0;
+    for (int s = 0; s < getNumOfShards(); s++)
+      rows += channel(s).intArg;
+
+    EigenDoubleRowMajorMat records(rows, width);
+    droppedEpisodes_ = 0;
+    for (int s = 0, row = 0; s < getNumOfShards(); s++) {
+      const int count = channel(s).intArg;
+      records.middleRows(row, count) = Eigen::Map<const EigenDoubleRowMajorMat>(episodeRecords(s, width), count, width);
+      records.middleRows(row, count).col(EpisodeStatistics::ENV).array() += envOffset_[s];
+      droppedEpisodes_ += uint64_t(channel(s).doubleArg);
+      row += count;
+    }
+    return records;
+  }
+
+  std::vector<std::string> getEpisodeStatsTag() { return EpisodeStatistics::columns(stepDataTag_); }
+  uint64_t getDroppedEpisodeCount() { return droppedEpisodes_; }
+
+  void getState(Eigen::Ref<EigenVec> gc, Eigen::Ref<EigenVec> gv) {
+    RSFATAL_IF(gc.size() > maxStateDim || gv.size() > maxStateDim, "state too large for the shard segment")
+    runOn(0, GET_STATE, int(gc.size()), double(gv.size()));
+    const float *state = reinterpret_cast<const float *>(segment_ + header_->stateOffset);
+    gc = Eigen::Map<const EigenVec>(state, gc.size());
+    gv = Eigen::Map<const EigenVec>(state + maxStateDim, gv.size());
+  }
+
+  void getStates(Eigen::Ref<EigenDoubleRowMajorMat>, Eigen::Ref<EigenDoubleRowMajorMat>) {
+    RSFATAL("sharded environments return the state of environment 0 only (getState)")
+  }
+  void setStates(const Eigen::Ref<const EigenDoubleRowMajorMat>&, const Eigen::Ref<const EigenDoubleRowMajorMat>&) {
+    RSFATAL("sharded environments cannot set the states")
+  }
+
+  void step(Eigen::Ref<EigenRowMajorMat> &action,
+            Eigen::Ref<EigenVec> &reward,
+            Eigen::Ref<EigenBoolVec> &done) {
+    stepShards(STEP, action, reward, done);
+  }
+
+  void step_visualize(Eigen::Ref<EigenRowMajorMat> &action,
+                      Eigen::Ref<EigenVec> &reward,
+                      Eigen::Ref<EigenBoolVec> &done) {
+    stepShards(STEP_VISUALIZE, action, reward, done);
+  }
+
+  void turnOnVisualization() { runOn(0, TURN_ON_VISUALIZATION); }
+  void turnOffVisualization() { runOn(0, TURN_OFF_VISUALIZATION); }
+  void startRecordingVideo(const std::string& videoName) {
+    RSFATAL_IF(videoName.size() >= textSize, "video name too long")
+    std::strcpy(channel(0).text, videoName.c_str());
+    runOn(0, START_RECORDING);
+  }
+  void stopRecordingVideo() { runOn(0, STOP_RECORDING); }
+
+  void startRecordingTrajectory(const std::string& fileName, int id) {
+    const int s = shardOf(id);
+    RSFATAL_IF(s < 0, "invalid environment id "<<id)
+    RSFATAL_IF(fileName.size() >= textSize, "trajectory file name too long")
+    std::strcpy(channel(s).text, fileName.c_str());
+    runOn(s, START_TRAJECTORY, id - envOffset_[s]);
+  }
+
+  uint64_t stopRecordingTrajectory(int id) {
+    const int s = shardOf(id);
+    RSFATAL_IF(s < 0, "invalid environment id "<<id)
+    runOn(s, STOP_TRAJECTORY, id - envOffset_[s]);
+    return uint64_t(channel(s).doubleArg);
+  }
+
+  void startLogging(const std::string&, const std::vector<int>&, int) {
+    RSFATAL("sharded environments do not support the columnar step log")
+  }
+  uint64_t stopLogging() { return 0; }
+  void getObStatistics(Eigen::Ref<EigenVec> &mean, Eigen::Ref<EigenVec> &var, float &count) {
+    obNormalizer_.getStatistics(mean, var, count); }
+  void setObStatistics(Eigen::Ref<EigenVec> &mean, Eigen::Ref<EigenVec> &var, float count) {
+    obNormalizer_.setStatistics(mean, var, count); }
+  void saveObStatistics(const std::string& fileName) { ObservationNormalizer::save(fileName, {&obNormalizer_}); }
+  bool loadObStatistics(const std::string& fileName) {
+    auto normalizers = ObservationNormalizer::load(fileName);
+    RSFATAL_IF(normalizers.empty() || normalizers[0].obDim() != getObDim(), fileName<<" does not match the observation")
+    obNormalizer_ = normalizers[0];
+    return normalizers.size() > 1;
+  }
+
+  void setSeed(int seed) { runOnAll(SET_SEED, seed); }
+
+  void moveControllerCursor(int id, Eigen::Ref<EigenVec> pos) {
+    const int s = shardOf(id);
+    if (s < 0) return;
+    float *state = reinterpret_cast<float *>(segment_ + header_->stateOffset);
+    Eigen::Map<EigenVec>(state, pos.size()) = pos;
+    runOn(s, MOVE_CURSOR, id - envOffset_[s], double(pos.size()));
+  }
+
+  void setCommand(int id) {
+    const int s = shardOf(id);
+    if (s >= 0) runOn(s, SET_COMMAND, id - envOffset_[s]);
+  }
+
+  void close() { runOnAll(CLOSE); }
+
+  void isTerminalState(Eigen::Ref<EigenBoolVec>& terminalState) {
+    runOnAll(IS_TERMINAL);
+    terminalState = dones();
+  }
+
+  void setSimulationTimeStep(double dt) { runOnAll(SET_SIMULATION_DT, 0, dt); }
+  void setControlTimeStep(double dt) { runOnAll(SET_CONTROL_DT, 0, dt); }
+
+  int getObDim() { return ChildEnvironment::getObDim(); }
+  int getCriticObDim() { return getObDim(); }
+  bool hasSeparateCriticObservation() { return false; }
+  std::string getCompactObservationType() { return "float32"; }
+  int getActionDim() { return ChildEnvironment::getActionDim(); }
+  int getNumOfEnvs() { return num_envs_; }
+  int getNumOfShards() { return int(pids_.size()); }
+
+  /// phases timed in the trainer process (the step round trip, the gather and the normalization)
+  std::map<std::string, std::map<std::string, double>> getProfile() { return profiler::getProfile(); }
+  void resetProfile() { profiler::resetProfile(); }
+
+  void curriculumUpdate() {
+    RSG_PROFILE_SCOPE(VEC_CURRICULUM)
+    runOnAll(CURRICULUM);
+  }
+
+  /// the command loop of a worker process. Returns the exit code
+  static int runWorker(const std::string &resourceDir, const std::string &segmentName, int shard) {
+    int fd = shm_open(segmentName.c_str(), O_RDWR, 0600);
+    RSFATAL_IF(fd < 0, "cannot open the shared memory segment "<<segmentName)
+    Header header;
+    RSFATAL_IF(pread(fd, &header, sizeof(Header), 0) != sizeof(Header) || header.magic != magic,
+               segmentName<<" is not a shard segment")
+    struct stat st;
+    fstat(fd, &st);
+    const size_t size = size_t(st.st_size);
+    void *mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    RSFATAL_IF(mapped == MAP_FAILED, "cannot map the shared memory segment "<<segmentName)
+    char *segment = static_cast<char *>(mapped);
+    Channel &ch = *reinterpret_cast<Channel *>(segment + header.channelOffset + sizeof(Channel) * shard);
+
+    /// views of this shard's rows
+    const int offset = ch.envOffset, count = ch.envCount;
+    Eigen::Map<EigenRowMajorMat> actionMap(reinterpret_cast<float *>(segment + header.actionOffset) + offset * header.actionDim, count, header.actionDim);
+    Eigen::Map<EigenRowMajorMat> obMap(reinterpret_cast<float *>(segment + header.obOffset) + offset * header.obDim, count, header.obDim);
+    Eigen::Map<EigenVec> rewardMap(reinterpret_cast<float *>(segment + header.rewardOffset) + offset, count);
+    Eigen::Map<EigenBoolVec> doneMap(reinterpret_cast<bool *>(segment + header.doneOffset) + offset, count);
+    float *state = reinterpret_cast<float *>(segment + header.stateOffset);
+    Eigen::Ref<EigenRowMajorMat> action(actionMap), ob(obMap);
+    Eigen::Ref<EigenVec> reward(rewardMap);
+    Eigen::Ref<EigenBoolVec> done(doneMap);
+
+    std::unique_ptr<VectorizedEnvironment<ChildEnvironment>> env;
+    int stepDataDim = 0;
+    uint32_t seen = 0;
+
+    while (true) {
+      uint32_t request;
+      while ((request = ch.request.load(std::memory_order_acquire)) == seen)
+        futexWait(&ch.request, seen, -1);
+      seen = request;
+      const int32_t command = ch.command;
+      ch.status = 0;
+
+      try {
+        switch (command) {
+          case INIT: {
+            env = std::make_unique<VectorizedEnvironment<ChildEnvironment>>(
+                resourceDir, std::string(segment + ch.cfgOffset, ch.cfgSize));
+            env->init();
+            std::string tags;
+            for (auto &tag: env->getStepDataTag())
+              tags += tag + "\n";
+            stepDataDim = int(env->getStepDataTag().size());
+            RSFATAL_IF(stepDataDim > maxStepDataDim, "more than "<<maxStepDataDim<<" step data entries")
+            RSFATAL_IF(tags.size() >= textSize, "step data tags too long")
+            std::strcpy(ch.text, tags.c_str());
+            break;
+          }
+          case STEP: env->step(action, reward, done); break;
+          case STEP_VISUALIZE: env->step_visualize(action, reward, done); break;
+          case OBSERVE: env->observeRaw(ob); break;
+          case RESET: env->reset(); break;
+          case CURRICULUM: env->curriculumUpdate(); break;
+          case SET_SEED: env->setSeed(ch.intArg + offset); break;
+          case GET_STEP_DATA: {
+            Eigen::Map<EigenDoubleRowMajorMat> rows(
+                reinterpret_cast<double *>(segment + header.stepDataOffset) + offset * stepDataDim, count, stepDataDim);
+            env->getStepDataRows(rows);
+            break;
+          }
+          case GET_EPISODE_STATS: {
+            const int width = EpisodeStatistics::TERMS + stepDataDim;
+            EigenDoubleRowMajorMat records = env->getEpisodeStats(ch.intArg != 0, maxEpisodeRecords + count);
+            Eigen::Map<EigenDoubleRowMajorMat>(reinterpret_cast<double *>(segment + header.episodeOffset) +
+                                               size_t(shard * maxEpisodeRecords + offset) * width,
+                                               records.rows(), width) = records;
+            ch.intArg = int(records.rows());
+            ch.doubleArg = double(env->getDroppedEpisodeCount());
+            break;
+          }
+          case IS_TERMINAL: env->isTerminalState(done); break;
+          case GET_STATE:
+            env->getState(Eigen::Map<EigenVec>(state, ch.intArg), Eigen::Map<EigenVec>(state + maxStateDim, int(ch.doubleArg)));
+            break;
+          case SET_COMMAND: env->setCommand(ch.intArg); break;
+          case MOVE_CURSOR: env->moveControllerCursor(ch.intArg, Eigen::Map<EigenVec>(state, int(ch.doubleArg))); break;
+          case TURN_ON_VISUALIZATION: env->turnOnVisualization(); break;
+          case TURN_OFF_VISUALIZATION: env->turnOffVisualization(); break;
+          case START_RECORDING: env->startRecordingVideo(std::string(ch.text)); break;
+          case STOP_RECORDING: env->stopRecordingVideo(); break;
+          case START_TRAJECTORY: env->startRecordingTrajectory(std::string(ch.text), ch.intArg); break;
+          case STOP_TRAJECTORY: ch.doubleArg = double(env->stopRecordingTrajectory(ch.intArg)); break;
+          case SET_SIMULATION_DT: env->setSimulationTimeStep(ch.doubleArg); break;
+          case SET_CONTROL_DT: env->setControlTimeStep(ch.doubleArg); break;
+          case CLOSE: env->close(); break;
+          case EXIT: env.reset(); break;
+          default: RSFATAL("unknown shard command "<<command)
+        }
+      } catch (const std::exception &e) {
+        ch.status = 1;
+        std::strncpy(ch.text, e.what(), textSize - 1);
+        ch.text[textSize - 1] = '\0';
+      } catch (...) {
+        ch.status = 1;
+        std::strcpy(ch.text, "unknown error");
+      }
+
+      ch.response.store(seen, std::memory_order_release);
+      futexWake(&ch.response);
+      if (command == EXIT) break;
+    }
+
+    munmap(segment, size);
+    return 0;
+  }
+
+ private:
+  static void futexWait(std::atomic<uint32_t> *word, uint32_t expected, int timeoutMs) {
+    timespec timeout{timeoutMs / 1000, (timeoutMs % 1000) * 1000000L};
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAIT, expected, timeoutMs >= 0 ? &timeout : nullptr,
+            nullptr, 0);
+  }
+
+  static void futexWake(std::atomic<uint32_t> *word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+  }
+
+  Channel &channel(int shard) {
+    return *reinterpret_cast<Channel *>(segment_ + header_->channelOffset + sizeof(Channel) * shard);
+  }
+
+  /// the rows of shard s in the episode region: maxEpisodeRecords plus one per environment of the shard
+  const double *episodeRecords(int s, int width) {
+    return reinterpret_cast<const double *>(segment_ + header_->episodeOffset) + size_t(s * maxEpisodeRecords + envOffset_[s]) * width;
+  }
+
+  Eigen::Map<EigenRowMajorMat> actions() {
+    return {reinterpret_cast<float *>(segment_ + header_->actionOffset), num_envs_, header_->actionDim}; }
+  Eigen::Map<EigenRowMajorMat> observations() {
+    return {reinterpret_cast<float *>(segment_ + header_->obOffset), num_envs_, header_->obDim}; }
+  Eigen::Map<EigenVec> rewards() { return {reinterpret_cast<float *>(segment_ + header_->rewardOffset), num_envs_}; }
+  Eigen::Map<EigenBoolVec> dones() { return {reinterpret_cast<bool *>(segment_ + header_->doneOffset), num_envs_}; }
+
+  int shardOf(int id) const {
+    for (int s = 0; s < int(envOffset_.size()); s++)
+      if (id >= envOffset_[s] && id < envOffset_[s] + envCount_[s]) return s;
+    return -1;
+  }
+
+  void post(int shard) {
+    channel(shard).request.fetch_add(1, std::memory_order_release);
+    futexWake(&channel(shard).request);
+  }
+
+  /// waits for the response to the last request. Polls the worker every 100 ms, so a crashed worker is reported
+  /// instead of blocking forever
+  void wait(int shard) {
+    Channel &ch = channel(shard);
+    const uint32_t expected = ch.request.load(std::memory_order_relaxed);
+    uint32_t response;
+    while ((response = ch.response.load(std::memory_order_acquire)) != expected) {
+      futexWait(&ch.response, response, 100);
+      int status;
+      if (ch.response.load(std::memory_order_acquire) != expected && waitpid(pids_[shard], &status, WNOHANG) == pids_[shard]) {
+        pids_[shard] = -1;
+        RSFATAL("shard "<<shard<<" worker "<<(WIFSIGNALED(status) ? "was killed by signal " + std::to_string(WTERMSIG(status))
+                                                                : "exited with code " + std::to_string(WEXITSTATUS(status))))
+      }
+    }
+    RSFATAL_IF(ch.status != 0, "shard "<<shard<<": "<<ch.text)
+  }
+
+  void runOn(int shard, Command command, int intArg = 0, double doubleArg = 0.) {
+    RSFATAL_IF(pids_[shard] <= 0, "shard "<<shard<<" worker is not running")
+    Channel &ch = channel(shard);
+    ch.command = command;
+    ch.intArg = intArg;
+    ch.doubleArg = doubleArg;
+    post(shard);
+    wait(shard);
+  }
+
+  void runOnAll(Command command, int intArg = 0, double doubleArg = 0.) {
+    for (int s = 0; s < int(pids_.size()); s++) {
+      RSFATAL_IF(pids_[s] <= 0, "shard "<<s<<" worker is not running")
+      Channel &ch = channel(s);
+      ch.command = command;
+      ch.intArg = intArg;
+      ch.doubleArg = doubleArg;
+      post(s);
+    }
+    for (int s = 0; s < int(pids_.size()); s++)
+      wait(s);
+  }
+
+  void stepShards(Command command, Eigen::Ref<EigenRowMajorMat> &action, Eigen::Ref<EigenVec> &reward,
+                  Eigen::Ref<EigenBoolVec> &done) {
+    RSG_PROFILE_SCOPE(VEC_STEP)
+    actions() = action;
+    runOnAll(command);
+    reward = rewards();
+    done = dones();
+  }
+
+  std::string resourceDir_, cfgString_, workerExecutable_;
+  Yaml::Node cfg_;
+  int num_envs_ = 1;
+  std::vector<int> envOffset_, envCount_;
+  std::vector<pid_t> pids_;
+  std::vector<std::string> stepDataTag_;
+  EigenDoubleRowMajorMat stepDataRows_;
+  uint64_t droppedEpisodes_ = 0;
+
+  char *segment_ = nullptr;
+  size_t segmentSize_ = 0;
+  Header *header_ = nullptr;
+  ObservationNormalizer obNormalizer_;
+};
+
+}
+
+#endif //__linux__
+
+#endif //SRC_RAISIMGYMSHARDEDVECENV_HPP
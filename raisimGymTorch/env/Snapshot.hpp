@@ -0,0 +1,104 @@
+//----------------------------//
+// This file is part of RaiSim//
+// Copyright 2020, RaiSim Tech//
+//----------------------------//
+
+#ifndef SRC_RAISIMGYMSNAPSHOT_HPP
+#define SRC_RAISIMGYMSNAPSHOT_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <Eigen/Core>
+
+namespace raisim {
+
+/// Binary blob of an environment state. The blob starts with a magic number, a format version and a layout id
+/// (e.g., the observation dimension) so that blobs of a different environment or version are rejected on load.
+/// Values are stored in the native byte order; blobs are meant for checkpoints on the same kind of machine.
+class SnapshotWriter {
+ public:
+  static constexpr uint32_t magic = 0x53534752; /// "RGSS"
+
+  SnapshotWriter(std::string& blob, uint32_t version, uint32_t layoutId) : blob_(blob) {
+    blob_.clear();
+    write(magic);
+    write(version);
+    write(layoutId);
+  }
+
+  template<typename T>
+  void write(const T& value) {
+    static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable types can be written directly");
+    blob_.append(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  template<typename Derived>
+  void writeVector(const Eigen::DenseBase<Derived>& vec) {
+    using Scalar = typename Derived::Scalar;
+    write(uint32_t(vec.size()));
+    for (Eigen::Index i = 0; i < vec.size(); i++)
+      write(Scalar(vec.derived().coeff(i)));
+  }
+
+  /// standard random engines and distributions only expose their state through streams
+  template<typename T>
+  void writeStreamable(const T& value) {
+    std::ostringstream ss;
+    ss << value;
+    write(uint32_t(ss.str().size()));
+    blob_.append(ss.str());
+  }
+
+ private:
+  std::string& blob_;
+};
+
+class SnapshotReader {
+ public:
+  SnapshotReader(const std::string& blob, uint32_t version, uint32_t layoutId) : blob_(blob) {
+    RSFATAL_IF(read<uint32_t>() != SnapshotWriter::magic, "not an environment snapshot")
+    RSFATAL_IF(read<uint32_t>() != version, "snapshot version mismatch")
+    RSFATAL_IF(read<uint32_t>() != layoutId, "the snapshot was taken from a different environment")
+  }
+
+  template<typename T>
+  T read() {
+    static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable types can be read directly");
+    RSFATAL_IF(pos_ + sizeof(T) > blob_.size(), "truncated snapshot")
+    T value;
+    std::memcpy(&value, blob_.data() + pos_, sizeof(T));
+    pos_ += sizeof(T);
+    return value;
+  }
+
+  /// the size of vec must match the stored size
+  template<typename Derived>
+  void readVector(Eigen::DenseBase<Derived>& vec) {
+    using Scalar = typename Derived::Scalar;
+    RSFATAL_IF(read<uint32_t>() != uint32_t(vec.size()), "snapshot vector size mismatch")
+    for (Eigen::Index i = 0; i < vec.size(); i++)
+      vec.derived().coeffRef(i) = read<Scalar>();
+  }
+
+  template<typename T>
+  void readStreamable(T& value) {
+    const auto size = read<uint32_t>();
+    RSFATAL_IF(pos_ + size > blob_.size(), "truncated snapshot")
+    std::istringstream ss(blob_.substr(pos_, size));
+    ss >> value;
+    pos_ += size;
+  }
+
+  [[nodiscard]] bool finished() const { return pos_ == blob_.size(); }
+
+ private:
+  const std::string& blob_;
+  size_t pos_ = 0;
+};
+
+}
+
+#endif //SRC_RAISIMGYMSNAPSHOT_HPP
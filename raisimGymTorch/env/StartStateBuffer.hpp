@@ -0,0 +1,91 @@
+//----------------------------//
+// This file is part of RaiSim//
+// Copyright 2020, RaiSim Tech//
+//----------------------------//
+
+#ifndef SRC_RAISIMGYMSTARTSTATEBUFFER_HPP
+#define SRC_RAISIMGYMSTARTSTATEBUFFER_HPP
+
+#include <atomic>
+#include <memory>
+#include <Eigen/Core>
+#include "Snapshot.hpp"
+
+namespace raisim {
+
+/// Fixed-capacity ring of recorded (gc, gv) states that resets can start from.
+/// Only the owning environment records into a buffer, but with a shared pool other environments read from it
+/// while it is being written. Every slot is therefore guarded by a sequence counter (seqlock): load() fails
+/// instead of returning a partially written state.
+class StartStateBuffer {
+ public:
+  void resize(int capacity, int gcDim, int gvDim) {
+    capacity_ = capacity;
+    gc_.setZero(gcDim, capacity);
+    gv_.setZero(gvDim, capacity);
+    sequence_ = std::make_unique<std::atomic<uint32_t>[]>(capacity);
+    for (int i = 0; i < capacity; i++)
+      sequence_[i].store(0, std::memory_order_relaxed);
+    recorded_.store(0, std::memory_order_relaxed);
+  }
+
+  void record(const Eigen::VectorXd& gc, const Eigen::VectorXd& gv) {
+    if (capacity_ == 0) return;
+    const uint64_t recorded = recorded_.load(std::memory_order_relaxed);
+    const int slot = int(recorded % capacity_);
+    const uint32_t sequence = sequence_[slot].load(std::memory_order_relaxed);
+    sequence_[slot].store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    gc_.col(slot) = gc;
+    gv_.col(slot) = gv;
+    sequence_[slot].store(sequence + 2, std::memory_order_release);
+    recorded_.store(recorded + 1, std::memory_order_release);
+  }
+
+  /// number of slots holding a state
+  [[nodiscard]] int size() const {
+    return int(std::min<uint64_t>(recorded_.load(std::memory_order_acquire), uint64_t(capacity_)));
+  }
+
+  /// copies the state of a slot. Returns false if the slot is empty or was being written
+  bool load(int slot, Eigen::VectorXd& gc, Eigen::VectorXd& gv) const {
+    const uint32_t before = sequence_[slot].load(std::memory_order_acquire);
+    if (before == 0 || (before & 1u)) return false;
+    gc = gc_.col(slot);
+    gv = gv_.col(slot);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return sequence_[slot].load(std::memory_order_relaxed) == before;
+  }
+
+  void writeSnapshot(SnapshotWriter& writer) const {
+    writer.write(int32_t(capacity_));
+    writer.write(uint64_t(recorded_.load(std::memory_order_relaxed)));
+    for (int i = 0; i < size(); i++) {
+      writer.writeVector(gc_.col(i));
+      writer.writeVector(gv_.col(i));
+    }
+  }
+
+  void readSnapshot(SnapshotReader& reader) {
+    RSFATAL_IF(reader.read<int32_t>() != capacity_, "the snapshot has a different start state buffer capacity")
+    resize(capacity_, int(gc_.rows()), int(gv_.rows()));
+    recorded_.store(reader.read<uint64_t>(), std::memory_order_relaxed);
+    for (int i = 0; i < size(); i++) {
+      auto gc = gc_.col(i);
+      auto gv = gv_.col(i);
+      reader.readVector(gc);
+      reader.readVector(gv);
+      sequence_[i].store(2, std::memory_order_relaxed);
+    }
+  }
+
+ private:
+  int capacity_ = 0;
+  Eigen::MatrixXd gc_, gv_; /// one column per slot
+  std::unique_ptr<std::atomic<uint32_t>[]> sequence_;
+  std::atomic<uint64_t> recorded_{0};
+};
+
+}
+
+#endif //SRC_RAISIMGYMSTARTSTATEBUFFER_HPP
@@ -0,0 +1,91 @@
+//----------------------------//
+// This file is part of RaiSim//
+// Copyright 2020, RaiSim Tech//
+//----------------------------//
+
+#ifndef SRC_RAISIMGYMTHREADPLACEMENT_HPP
+#define SRC_RAISIMGYMTHREADPLACEMENT_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+namespace raisim {
+namespace placement {
+
+/// parses a cpu list such as "0-15,32-47"
+inline std::vector<int> parseCpuList(const std::string& list) {
+  std::vector<int> cpus;
+  size_t begin = 0;
+  while (begin < list.size()) {
+    size_t end = list.find(',', begin);
+    if (end == std::string::npos) end = list.size();
+    const std::string range = list.substr(begin, end - begin);
+    if (!range.empty()) {
+      const size_t dash = range.find('-');
+      const int first = std::stoi(range.substr(0, dash));
+      const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+      RSFATAL_IF(last < first, "invalid cpu range "<<range)
+      for (int cpu = first; cpu <= last; cpu++)
+        cpus.push_back(cpu);
+    }
+    begin = end + 1;
+  }
+  return cpus;
+}
+
+/// pins the calling thread to a cpu. Returns false if pinning is not supported or not permitted
+inline bool pinCurrentThread(int cpu) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
+
+/// the cpu the calling thread runs on (-1 if unknown)
+inline int currentCpu() {
+#ifdef __linux__
+  return sched_getcpu();
+#else
+  return -1;
+#endif
+}
+
+/// NUMA node of a cpu (-1 if unknown)
+inline int nodeOfCpu(int cpu) {
+#ifdef __linux__
+  if (cpu < 0) return -1;
+  for (int node = 0; node < 64; node++)
+    if (access(("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/node" + std::to_string(node)).c_str(), F_OK) == 0)
+      return node;
+#endif
+  return -1;
+}
+
+/// NUMA node of the page holding an address (-1 if unknown). Queried with move_pages, which moves nothing if no
+/// target nodes are given
+inline int nodeOfAddress(const void* address) {
+#if defined(__linux__) && defined(SYS_move_pages)
+  const long pageSize = sysconf(_SC_PAGESIZE);
+  void* page = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(address) & ~uintptr_t(pageSize - 1));
+  int status = -1;
+  if (syscall(SYS_move_pages, 0, 1, &page, nullptr, &status, 0) == 0 && status >= 0)
+    return status;
+#endif
+  return -1;
+}
+
+}
+}
+
+#endif //SRC_RAISIMGYMTHREADPLACEMENT_HPP
@@ -0,0 +1,170 @@
+//----------------------------//
+// This file is part of RaiSim//
+// Copyright 2020, RaiSim Tech//
+//----------------------------//
+
+#ifndef SRC_RAISIMGYMTRACER_HPP
+#define SRC_RAISIMGYMTRACER_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+namespace raisim {
+
+/// Timeline of the vectorized stepping in the Chrome trace format (chrome://tracing, ui.perfetto.dev).
+/// Every worker thread writes begin/end events into its own preallocated ring buffer, so recording takes no lock
+/// and never allocates. When a ring buffer is full, its oldest events are overwritten.
+/// start(), stop() and dump() must be called outside of the parallel regions.
+class Tracer {
+ public:
+  enum class Event : uint8_t {
+    STEP = 0,
+    TERMINAL,
+    RESET,
+    OBSERVE,
+    BATCH_STEP,    /// a whole parallel step loop, recorded by the calling thread
+    BATCH_OBSERVE,
+    BATCH_RESET,
+    COUNT
+  };
+
+  class Scope {
+   public:
+    Scope(Tracer& tracer, int thread, Event event, int envId) :
+        tracer_(tracer.enabled() ? &tracer : nullptr), thread_(thread), event_(event), envId_(envId) {
+      if (tracer_) begin_ = tracer_->now();
+    }
+
+    ~Scope() {
+      if (tracer_) tracer_->record(thread_, event_, envId_, begin_, tracer_->now());
+    }
+
+   private:
+    Tracer* tracer_;
+    int thread_;
+    Event event_;
+    int envId_;
+    int64_t begin_ = 0;
+  };
+
+  void start(int threadCount, size_t eventsPerThread) {
+    buffers_.assign(threadCount, ThreadBuffer());
+    for (auto& buffer: buffers_)
+      buffer.records.resize(eventsPerThread);
+    origin_ = std::chrono::steady_clock::now();
+    enabled_ = eventsPerThread > 0;
+  }
+
+  void stop() { enabled_ = false; }
+
+  [[nodiscard]] bool enabled() const { return enabled_; }
+
+  [[nodiscard]] int64_t now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin_).count();
+  }
+
+  void record(int thread, Event event, int envId, int64_t begin, int64_t end) {
+    if (thread < 0 || thread >= int(buffers_.size())) return;
+    auto& buffer = buffers_[thread];
+    buffer.records[buffer.count % buffer.records.size()] = {begin, end, envId, event};
+    buffer.count++;
+  }
+
+  /// writes the recorded events as Chrome trace JSON. For every batch event, the time between the last event of
+  /// a worker thread and the end of the batch is written as a "barrier_wait" event of that thread
+  void dump(const std::string& fileName) const {
+    std::ofstream file(fileName);
+    RSFATAL_IF(!file.is_open(), "cannot open "<<fileName)
+    /// timestamps in microseconds with nanosecond digits, so that long traces keep their resolution
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    auto writeEvent = [&](int thread, const char* name, int envId, int64_t begin, int64_t end) {
+      file << (first ? "" : ",\n") << "{\"name\": \"" << name << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << thread
+           << ", \"ts\": " << double(begin) * 1e-3 << ", \"dur\": " << double(end - begin) * 1e-3;
+      if (envId >= 0) file << ", \"args\": {\"env\": " << envId << "}";
+      file << "}";
+      first = false;
+    };
+
+    std::vector<std::vector<Record>> threadRecords(buffers_.size());
+    for (size_t t = 0; t < buffers_.size(); t++) {
+      threadRecords[t] = buffers_[t].ordered();
+      file << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": " << t
+           << ", \"args\": {\"name\": \"worker " << t << "\"}}";
+      first = false;
+      for (auto& record: threadRecords[t])
+        writeEvent(int(t), eventName(record.event), isBatch(record.event) ? -1 : record.envId, record.begin, record.end);
+    }
+
+    std::vector<Record> batches;
+    for (auto& records: threadRecords)
+      for (auto& record: records)
+        if (isBatch(record.event)) batches.push_back(record);
+    std::sort(batches.begin(), batches.end(), [](const Record& a, const Record& b) { return a.begin < b.begin; });
+
+    /// the records of a thread are in chronological order, so one sweep per thread suffices
+    for (size_t t = 0; t < threadRecords.size(); t++) {
+      auto& records = threadRecords[t];
+      size_t idx = 0;
+      for (auto& batch: batches) {
+        int64_t lastEnd = -1;
+        while (idx < records.size() && records[idx].begin < batch.end) {
+          auto& record = records[idx++];
+          if (!isBatch(record.event) && record.begin >= batch.begin && record.end <= batch.end)
+            lastEnd = std::max(lastEnd, record.end);
+        }
+        if (lastEnd >= 0)
+          writeEvent(int(t), "barrier_wait", -1, lastEnd, batch.end);
+      }
+    }
+    file << "\n]}\n";
+  }
+
+ private:
+  struct Record {
+    int64_t begin, end;
+    int32_t envId;
+    Event event;
+  };
+
+  /// aligned so that the counters of neighboring threads are on different cache lines
+  struct alignas(64) ThreadBuffer {
+    std::vector<Record> records;
+    uint64_t count = 0;
+
+    /// recorded events, oldest first
+    [[nodiscard]] std::vector<Record> ordered() const {
+      std::vector<Record> out;
+      if (records.empty()) return out;
+      const uint64_t size = std::min<uint64_t>(count, records.size());
+      for (uint64_t i = count - size; i < count; i++)
+        out.push_back(records[i % records.size()]);
+      return out;
+    }
+  };
+
+  static bool isBatch(Event event) {
+    return event == Event::BATCH_STEP || event == Event::BATCH_OBSERVE || event == Event::BATCH_RESET;
+  }
+
+  static const char* eventName(Event event) {
+    static constexpr std::array<const char*, int(Event::COUNT)> names = {
+        "step", "terminal", "reset", "observe", "batch_step", "batch_observe", "batch_reset"};
+    return names[int(event)];
+  }
+
+  std::vector<ThreadBuffer> buffers_;
+  std::chrono::steady_clock::time_point origin_;
+  bool enabled_ = false;
+};
+
+}
+
+#endif //SRC_RAISIMGYMTRACER_HPP
@@ -0,0 +1,225 @@
+//----------------------------//
+// This file is part of RaiSim//
+// Copyright 2020, RaiSim Tech//
+//----------------------------//
+
+#ifndef SRC_RAISIMGYMTRAJECTORYRECORDER_HPP
+#define SRC_RAISIMGYMTRAJECTORYRECORDER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Eigen/Core>
+
+namespace raisim {
+
+/// Binary trajectory of one environment for offline visualization (no RaisimServer needed while training).
+/// Layout: Header, then records of a RecordHeader and its payload, in the native byte order:
+///   TERRAIN: int32 xSamples, ySamples | double xSize, ySize, centerX, centerY | float heights[xSamples * ySamples]
+///   EPISODE: uint64 step (the frames from here on belong to a new episode)
+///   FRAME:   uint64 step | float gc[gcDim]
+/// The link poses follow from gc by the forward kinematics of the robot, so a frame is gcDim floats.
+/// Records are appended to a buffer that a background thread writes to the file, so recording never waits for the
+/// disk. When the buffer is full (the disk is slower than the simulation), records are dropped and counted.
+class TrajectoryRecorder {
+ public:
+  static constexpr uint32_t magic = 0x52544752; /// "RGTR"
+  static constexpr uint32_t version = 1;
+
+  struct Header {
+    uint32_t magic, version;
+    uint32_t gcDim, reserved;
+    double controlDt;
+  };
+
+  enum RecordType : uint32_t { TERRAIN = 1, EPISODE, FRAME };
+
+  struct RecordHeader {
+    uint32_t type, size; /// size of the payload in bytes
+  };
+
+  TrajectoryRecorder() = default;
+  TrajectoryRecorder(const TrajectoryRecorder&) = delete;
+  TrajectoryRecorder& operator=(const TrajectoryRecorder&) = delete;
+  ~TrajectoryRecorder() { stop(); }
+
+  /// bufferBytes: records held in memory while the previous ones are written
+  void start(const std::string &fileName, int gcDim, double controlDt, size_t bufferBytes = size_t(1) << 22) {
+    stop();
+    file_ = std::fopen(fileName.c_str(), "wb");
+    RSFATAL_IF(!file_, "cannot open "<<fileName)
+    gcDim_ = gcDim;
+    capacity_ = bufferBytes;
+    front_.clear();
+    front_.reserve(capacity_);
+    back_.clear();
+    back_.reserve(capacity_);
+    dropped_ = 0;
+    Header header{magic, version, uint32_t(gcDim), 0, controlDt};
+    std::fwrite(&header, sizeof(Header), 1, file_);
+    stop_ = false;
+    writer_ = std::thread(&TrajectoryRecorder::writeLoop, this);
+  }
+
+  /// writes the remaining records and closes the file
+  void stop() {
+    if (!writer_.joinable()) return;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    writer_.join();
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+
+  [[nodiscard]] bool recording() const { return writer_.joinable(); }
+  [[nodiscard]] uint64_t dropped() const { return dropped_; }
+
+  void terrain(int xSamples, int ySamples, double xSize, double ySize, double centerX, double centerY,
+               const std::vector<double> &heights) {
+    const int32_t samples[2] = {xSamples, ySamples};
+    const double geometry[4] = {xSize, ySize, centerX, centerY};
+    std::vector<float> heightsF(heights.begin(), heights.end());
+    append(TERRAIN, {{samples, sizeof(samples)}, {geometry, sizeof(geometry)},
+                     {heightsF.data(), sizeof(float) * heightsF.size()}});
+  }
+
+  void episode(uint64_t step) { append(EPISODE, {{&step, sizeof(step)}}); }
+
+  template<typename Derived>
+  void frame(uint64_t step, const Eigen::MatrixBase<Derived> &gc) {
+    Eigen::VectorXf gcF = gc.template cast<float>();
+    append(FRAME, {{&step, sizeof(step)}, {gcF.data(), sizeof(float) * size_t(gcDim_)}});
+  }
+
+ private:
+  struct Part {
+    const void *data;
+    size_t size;
+  };
+
+  void append(RecordType type, std::initializer_list<Part> parts) {
+    RecordHeader record{type, 0};
+    for (auto &part: parts) record.size += uint32_t(part.size);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (front_.size() + sizeof(RecordHeader) + record.size > capacity_) {
+      dropped_++;
+      return;
+    }
+    const auto *recordBytes = reinterpret_cast<const char *>(&record);
+    front_.insert(front_.end(), recordBytes, recordBytes + sizeof(RecordHeader));
+    for (auto &part: parts) {
+      const auto *bytes = static_cast<const char *>(part.data);
+      front_.insert(front_.end(), bytes, bytes + part.size);
+    }
+    cv_.notify_one();
+  }
+
+  /// swaps the buffers and writes the back buffer without holding the lock
+  void writeLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      cv_.wait(lock, [&]() { return stop_ || !front_.empty(); });
+      if (front_.empty() && stop_) break;
+      std::swap(front_, back_);
+      lock.unlock();
+      std::fwrite(back_.data(), 1, back_.size(), file_);
+      back_.clear();
+      lock.lock();
+    }
+    std::fflush(file_);
+  }
+
+  std::FILE *file_ = nullptr;
+  int gcDim_ = 0;
+  size_t capacity_ = 0;
+  std::vector<char> front_, back_;
+  std::atomic<uint64_t> dropped_{0};
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread writer_;
+  bool stop_ = false;
+};
+
+/// reads the records of a TrajectoryRecorder file one at a time
+class TrajectoryReader {
+ public:
+  using Header = TrajectoryRecorder::Header;
+  using RecordType = TrajectoryRecorder::RecordType;
+
+  struct Terrain {
+    int xSamples = 0, ySamples = 0;
+    double xSize = 0., ySize = 0., centerX = 0., centerY = 0.;
+    std::vector<double> heights;
+  };
+
+  explicit TrajectoryReader(const std::string &fileName) {
+    file_ = std::fopen(fileName.c_str(), "rb");
+    RSFATAL_IF(!file_, "cannot open "<<fileName)
+    RSFATAL_IF(std::fread(&header_, sizeof(Header), 1, file_) != 1 || header_.magic != TrajectoryRecorder::magic,
+               fileName<<" is not a trajectory file")
+    RSFATAL_IF(header_.version != TrajectoryRecorder::version, fileName<<" has version "<<header_.version
+               <<", expected "<<TrajectoryRecorder::version)
+  }
+  TrajectoryReader(const TrajectoryReader&) = delete;
+  TrajectoryReader& operator=(const TrajectoryReader&) = delete;
+  ~TrajectoryReader() { std::fclose(file_); }
+
+  [[nodiscard]] const Header &header() const { return header_; }
+
+  /// reads the next record into the argument of its type. Returns false at the end of the file
+  bool next(RecordType &type, uint64_t &step, Terrain &terrain, Eigen::VectorXd &gc) {
+    TrajectoryRecorder::RecordHeader record{};
+    if (std::fread(&record, sizeof(record), 1, file_) != 1) return false;
+    payload_.resize(record.size);
+    RSFATAL_IF(std::fread(payload_.data(), 1, record.size, file_) != record.size, "truncated trajectory record")
+    type = RecordType(record.type);
+    const char *p = payload_.data();
+    switch (type) {
+      case TrajectoryRecorder::TERRAIN: {
+        int32_t samples[2];
+        double geometry[4];
+        std::memcpy(samples, p, sizeof(samples));
+        std::memcpy(geometry, p + sizeof(samples), sizeof(geometry));
+        terrain.xSamples = samples[0];
+        terrain.ySamples = samples[1];
+        terrain.xSize = geometry[0];
+        terrain.ySize = geometry[1];
+        terrain.centerX = geometry[2];
+        terrain.centerY = geometry[3];
+        const auto *heights = reinterpret_cast<const float *>(p + sizeof(samples) + sizeof(geometry));
+        terrain.heights.assign(heights, heights + size_t(samples[0]) * samples[1]);
+        break;
+      }
+      case TrajectoryRecorder::EPISODE:
+        std::memcpy(&step, p, sizeof(step));
+        break;
+      case TrajectoryRecorder::FRAME:
+        std::memcpy(&step, p, sizeof(step));
+        gc = Eigen::Map<const Eigen::VectorXf>(reinterpret_cast<const float *>(p + sizeof(step)),
+                                                header_.gcDim).cast<double>();
+        break;
+      default:
+        break; /// unknown record types are skipped
+    }
+    return true;
+  }
+
+ private:
+  std::FILE *file_ = nullptr;
+  Header header_{};
+  std::vector<char> payload_;
+};
+
+}
+
+#endif //SRC_RAISIMGYMTRAJECTORYRECORDER_HPP
@@ -7,9 +7,26 @@
 #define SRC_RAISIMGYMVECENV_HPP
 
 #include "omp.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <utility>
 #include "Yaml.hpp"
 #include <Eigen/Core>
 #include "BasicEigenTypes.hpp"
+#include "ColumnarLog.hpp"
+#include "FrameStack.hpp"
+#include "CompactObservation.hpp"
+#include "EpisodeStatistics.hpp"
+#include "ObservationNormalizer.hpp"
+#include "Profiler.hpp"
+#include "ThreadPlacement.hpp"
+#include "Tracer.hpp"
 extern int THREAD_COUNT;
 
 namespace raisim {
@@ -27,6 +44,14 @@ class VectorizedEnvironment {
   }
 
   ~VectorizedEnvironment() {
+    if (asyncThread_.joinable()) {
+      {
+        std::lock_guard<std::mutex> lock(asyncMutex_);
+        asyncStop_ = true;
+      }
+      asyncCv_.notify_all();
+      asyncThread_.join();
+    }
     for (auto *ptr: environments_)
       delete ptr;
   }
@@ -35,56 +60,224 @@ class VectorizedEnvironment {
     THREAD_COUNT = cfg_["num_threads"].template As<int>();
     omp_set_num_threads(THREAD_COUNT);
     num_envs_ = cfg_["num_envs"].template As<int>();
+    doneIds_.reserve(num_envs_);
     double simDt, conDt;
     READ_YAML(double, simDt, cfg_["simulation_dt"])
     READ_YAML(double, conDt, cfg_["control_dt"])
 
-    for (int i = 0; i < num_envs_; i++) {
-      environments_.push_back(new ChildEnvironment(resourceDir_, cfg_, render_ && i == 0, i));
-      environments_.back()->setSimulationTimeStep(simDt);
-      environments_.back()->setControlTimeStep(conDt);
+    /// optionally pin the worker threads. Thread t runs on the (t % size)-th cpu of the list
+    const std::string cpuList = cfg_["thread_placement"]["cpus"].template As<std::string>("");
+    if (!cpuList.empty()) {
+      const auto cpus = placement::parseCpuList(cpuList);
+      RSFATAL_IF(cpus.empty(), "no cpu in thread_placement.cpus")
+#pragma omp parallel
+      if (!placement::pinCurrentThread(cpus[omp_get_thread_num() % cpus.size()]))
+        RSWARN("failed to pin worker thread "<<omp_get_thread_num())
     }
 
+    /// With first touch, every environment is constructed and initialized by the worker thread that steps it, so its
+    /// memory is allocated on the NUMA node of that thread. All loops over the environments use a static schedule, so
+    /// the environment-to-thread assignment does not change
+    firstTouch_ = cfg_["thread_placement"]["first_touch"].template As<bool>(false);
     int startSeed;
     READ_YAML(int, startSeed, cfg_["seed"])
+    /// id of the first environment. Shards of a ShardedVectorizedEnvironment hold a contiguous id range each
+    const int envIdOffset = cfg_["env_id_offset"].template As<int>(0);
+    environments_.resize(num_envs_);
+
+    /// a lookup of a missing key inserts it, even through a const Yaml::Node, so every thread reads its own copy
+    std::vector<Yaml::Node> threadCfgs(firstTouch_ ? THREAD_COUNT : 1, cfg_);
+#pragma omp parallel for schedule(static) if(firstTouch_)
     for (int i = 0; i < num_envs_; i++) {
+      const Yaml::Node &cfg = threadCfgs[omp_get_thread_num()];
+      environments_[i] = new ChildEnvironment(resourceDir_, cfg, render_ && i == 0, envIdOffset + i);
+      environments_[i]->setSimulationTimeStep(simDt);
+      environments_[i]->setControlTimeStep(conDt);
       environments_[i]->setSeed(startSeed + i);
       environments_[i]->init();
       environments_[i]->reset();
     }
 
+    /// env_major: every thread runs the whole control step of one environment before the next.
+    /// substep_major: all environments advance one sub-step at a time in lockstep, with batched passes in between
+    const std::string schedule = cfg_["step_schedule"].template As<std::string>("env_major");
+    RSFATAL_IF(schedule != "env_major" && schedule != "substep_major", "unknown step_schedule "<<schedule)
+    subStepMajor_ = schedule == "substep_major";
+
+    /// the per-step controller state of all environments in contiguous arrays, processed by batched kernels
+    controllerArena_ = cfg_["controller_arena"].template As<bool>(false);
+    if (controllerArena_)
+      ChildEnvironment::bindControllerArena(environments_);
+
+    /// with a shared start state pool, every environment resets from states recorded by any environment
+    if (cfg_["start_state_buffer"]["shared"].template As<bool>(false)) {
+      std::vector<const StartStateBuffer*> sources;
+      for (auto* env: environments_)
+        sources.push_back(env->getStartStateBuffer());
+      for (auto* env: environments_)
+        env->setStartStateSources(sources);
+    }
+
+    if (cfg_["thread_placement"]["report"].template As<bool>(false))
+      std::cout << getPlacementReport() << std::flush;
+
+    /// critic_observation: actor (the critic sees the actor observation) or privileged (ChildEnvironment's critic
+    /// observation, normalized with its own statistics)
+    const std::string criticObservation = cfg_["critic_observation"].template As<std::string>("actor");
+    RSFATAL_IF(criticObservation != "actor" && criticObservation != "privileged",
+               "unknown critic_observation "<<criticObservation)
+    separateCriticOb_ = criticObservation == "privileged";
+
     /// ob scaling
     if (normalizeObservation_) {
-      obMean_.setZero(getObDim());
-      obVar_.setOnes(getObDim());
-      recentMean_.setZero(getObDim());
-      recentVar_.setZero(getObDim());
-      delta_.setZero(getObDim());
-      epsilon.setZero(getObDim());
-      epsilon.setConstant(1e-8);
+      obNormalizer_.init(getObDim());
+      if (separateCriticOb_) criticObNormalizer_.init(getCriticObDim());
+    }
+
+    /// the last frame_stack.frames observations of every environment (see FrameStack)
+    const int frames = cfg_["frame_stack"]["frames"].template As<int>(0);
+    RSFATAL_IF(frames < 0, "frame_stack.frames must not be negative")
+    if (frames > 0)
+      frameStack_.init(num_envs_, frames, getObDim());
+
+    /// 16-bit copies of the normalized observations for a compact rollout storage (see CompactObservation)
+    const std::string compactType = cfg_["compact_observation"]["type"].template As<std::string>("float32");
+    RSFATAL_IF(compactType != "float32" && compactType != "float16" && compactType != "int16",
+               "unknown compact_observation.type "<<compactType<<". Use float32, float16 or int16")
+    const auto type = compactType == "float16" ? CompactObservation::Type::FLOAT16 :
+                      compactType == "int16" ? CompactObservation::Type::INT16 : CompactObservation::Type::FLOAT32;
+    const float range = cfg_["compact_observation"]["range"].template As<float>(8.f);
+    RSFATAL_IF(range <= 0.f, "compact_observation.range must be positive")
+    compactOb_.init(num_envs_, getObDim(), type, range);
+    if (separateCriticOb_) compactCriticOb_.init(num_envs_, getCriticObDim(), type, range);
+
+    /// groups of asyncReset/recv/send: contiguous ranges whose sizes differ by at most one
+    const int groupCount = cfg_["async_groups"].template As<int>(2);
+    RSFATAL_IF(groupCount < 1 || groupCount > num_envs_, "async_groups must be in [1, num_envs], got "<<groupCount)
+    groups_.resize(groupCount);
+    for (int g = 0, begin = 0; g < groupCount; g++) {
+      auto &group = groups_[g];
+      group.begin = begin;
+      group.count = num_envs_ / groupCount + (g < num_envs_ % groupCount);
+      group.action.setZero(group.count, getActionDim());
+      group.ob.setZero(group.count, getObDim());
+      group.reward.setZero(group.count);
+      group.done.setZero(group.count);
+      begin += group.count;
     }
+
+    /// return, length and reward-term sums of every finished episode (see EpisodeStatistics)
+    const int episodeCapacity = cfg_["episode_statistics"]["capacity"].template As<int>(4096);
+    RSFATAL_IF(episodeCapacity < 1, "episode_statistics.capacity must be positive")
+    episodeStats_.init(num_envs_, int(getStepDataTag().size()), THREAD_COUNT, episodeCapacity);
   }
 
   // resets all environments and returns observation
   void reset() {
-#pragma omp parallel for schedule(auto)
-    for (int i = 0; i < num_envs_; i++)
+    RSFATAL_IF(asyncStepping_ > 0, "groups are being stepped asynchronously. recv() them first")
+    RSG_PROFILE_SCOPE(VEC_RESET)
+    Tracer::Scope batchTrace(tracer_, 0, Tracer::Event::BATCH_RESET, -1);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < num_envs_; i++) {
+      Tracer::Scope trace(tracer_, omp_get_thread_num(), Tracer::Event::RESET, i);
       environments_[i]->reset();
+    }
+    if (frameStack_.enabled()) {
+      frameStack_.markEpisodeStart();
+      frameStackAdvance_ = true;
+    }
+    episodeStats_.restart();
   }
 
   void observe(Eigen::Ref<EigenRowMajorMat> &ob, bool updateStatistics=false) {
-#pragma omp parallel for schedule(auto)
-    for (int i = 0; i < num_envs_; i++)
-      environments_[i]->observe(ob.row(i));
+    observeRaw(ob);
+    normalizeAndStack(ob, updateStatistics);
+  }
+
+  /// the actor and the privileged critic observation (critic_observation: privileged) in one parallel pass
+  void observeWithCritic(Eigen::Ref<EigenRowMajorMat> &ob, Eigen::Ref<EigenRowMajorMat> &criticOb, bool updateStatistics=false) {
+    RSFATAL_IF(!separateCriticOb_, "critic_observation is not privileged. The critic observes the actor observation")
+    {
+      RSG_PROFILE_SCOPE(VEC_OBSERVE)
+      Tracer::Scope batchTrace(tracer_, 0, Tracer::Event::BATCH_OBSERVE, -1);
+#pragma omp parallel for schedule(static)
+      for (int i = 0; i < num_envs_; i++) {
+        Tracer::Scope trace(tracer_, omp_get_thread_num(), Tracer::Event::OBSERVE, i);
+        environments_[i]->observe(ob.row(i), criticOb.row(i));
+      }
+    }
 
     if (normalizeObservation_)
-      updateObservationStatisticsAndNormalize(ob, updateStatistics);
+      criticObNormalizer_.updateAndNormalize(criticOb, updateStatistics);
+    if (compactCriticOb_.enabled()) compactCriticOb_.quantize(criticOb);
+    normalizeAndStack(ob, updateStatistics);
+  }
+
+  /// frames of the observations returned by observe() (cfg: frame_stack.frames). The stack of all environments is
+  /// getFrameStack().data()[:, window:window + frames, :] with window = getFrameStackWindow()
+  FrameStack &getFrameStack() { return frameStack_; }
+  int getFrameStackWindow() { return frameStack_.window(); }
+
+  /// 16-bit copies of the last observations returned by observe() and observeWithCritic() (cfg: compact_observation)
+  CompactObservation &getCompactObservation() { return compactOb_; }
+  CompactObservation &getCompactCriticObservation() { return compactCriticOb_; }
+  std::string getCompactObservationType() {
+    return cfg_["compact_observation"]["type"].template As<std::string>("float32"); }
+  void getCompactObScale(Eigen::Ref<EigenVec> &scale) { scale = compactOb_.scale(); }
+  void getCompactCriticObScale(Eigen::Ref<EigenVec> &scale) { scale = compactCriticOb_.scale(); }
+
+  // fills the unnormalized observation. observe() = observeRaw() + updateObservationStatisticsAndNormalize()
+  void observeRaw(Eigen::Ref<EigenRowMajorMat> &ob) {
+    RSG_PROFILE_SCOPE(VEC_OBSERVE)
+    Tracer::Scope batchTrace(tracer_, 0, Tracer::Event::BATCH_OBSERVE, -1);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < num_envs_; i++) {
+      Tracer::Scope trace(tracer_, omp_get_thread_num(), Tracer::Event::OBSERVE, i);
+      environments_[i]->observe(ob.row(i));
+    }
   }
 
   std::vector<std::string> getStepDataTag() {
     return environments_[0]->getStepDataTag();
   }
 
+  /// the episodes finished since the last call, one row each (columns: getEpisodeStatsTag()). With flush, the
+  /// episodes in progress are also returned (terminal = 0) and their sums restart, so that the returns of all rows
+  /// add up to the rewards since the last flush
+  EigenDoubleRowMajorMat getEpisodeStats(bool flush=false, int maxRecords=std::numeric_limits<int>::max()) {
+    RSFATAL_IF(flush && asyncStepping_ > 0, "groups are being stepped asynchronously. recv() them before flushing")
+    return episodeStats_.drain(flush, maxRecords);
+  }
+
+  std::vector<std::string> getEpisodeStatsTag() { return EpisodeStatistics::columns(getStepDataTag()); }
+
+  /// finished episodes that did not fit into the queue (cfg: episode_statistics.capacity per thread)
+  uint64_t getDroppedEpisodeCount() { return episodeStats_.dropped(); }
+
+  /// logs gc, gv (float64), action, reward (float32), done and foot contacts (uint8) of the environments envIds after
+  /// every step() to a memory-mapped columnar file (see ColumnarLog), chunkSteps steps per chunk. Asynchronous
+  /// stepping is not logged
+  void startLogging(const std::string& fileName, const std::vector<int>& envIds, int chunkSteps) {
+    for (int id: envIds)
+      RSFATAL_IF(id < 0 || id >= num_envs_, "invalid environment id "<<id)
+    log_.clearColumns();
+    logColumns_ = {log_.addColumn("gc", ColumnarLog::FLOAT64, environments_[0]->getGcDim()),
+                   log_.addColumn("gv", ColumnarLog::FLOAT64, environments_[0]->getGvDim()),
+                   log_.addColumn("action", ColumnarLog::FLOAT32, getActionDim()),
+                   log_.addColumn("reward", ColumnarLog::FLOAT32, 1),
+                   log_.addColumn("done", ColumnarLog::UINT8, 1),
+                   log_.addColumn("contact", ColumnarLog::UINT8, ChildEnvironment::getContactDim())};
+    logEnvIds_ = envIds;
+    log_.start(fileName, envIds, chunkSteps);
+  }
+
+  /// writes the remaining steps and closes the file. Returns the number of logged steps
+  uint64_t stopLogging() {
+    const uint64_t steps = log_.steps();
+    log_.stop();
+    return steps;
+  }
+
   int getStepData(int sample_size,
                   Eigen::Ref<EigenDoubleVec> &mean,
                   Eigen::Ref<EigenDoubleVec> &squareSum,
@@ -93,6 +286,25 @@ class VectorizedEnvironment {
     size_t data_size = getStepDataTag().size();
     if( data_size == 0 ) return sample_size;
 
+    stepDataRows_.resize(num_envs_, data_size);
+    getStepDataRows(stepDataRows_);
+    return accumulateStepData(stepDataRows_, sample_size, mean, squareSum, min, max);
+  }
+
+  /// the step data of every environment, one row per environment
+  void getStepDataRows(Eigen::Ref<EigenDoubleRowMajorMat> rows) {
+    for (int i = 0; i < num_envs_; i++)
+      rows.row(i) = environments_[i]->getStepData().transpose();
+  }
+
+  /// folds one row per environment into the running mean, square sum and extrema of getStepData
+  static int accumulateStepData(const Eigen::Ref<const EigenDoubleRowMajorMat> &rows,
+                                int sample_size,
+                                Eigen::Ref<EigenDoubleVec> &mean,
+                                Eigen::Ref<EigenDoubleVec> &squareSum,
+                                Eigen::Ref<EigenDoubleVec> &min,
+                                Eigen::Ref<EigenDoubleVec> &max) {
+    const size_t data_size = rows.cols();
     RSFATAL_IF(mean.size() != data_size ||
         squareSum.size() != data_size ||
         min.size() != data_size ||
@@ -100,19 +312,19 @@ class VectorizedEnvironment {
 
     mean *= sample_size;
 
-    for (int i = 0; i < num_envs_; i++) {
-      mean += environments_[i]->getStepData();
+    for (int i = 0; i < rows.rows(); i++) {
+      mean += rows.row(i).transpose();
       for (int j = 0; j < data_size; j++) {
-        min(j) = std::min(min(j), environments_[i]->getStepData()[j]);
-        max(j) = std::max(max(j), environments_[i]->getStepData()[j]);
+        min(j) = std::min(min(j), rows(i, j));
+        max(j) = std::max(max(j), rows(i, j));
       }
     }
 
-    sample_size += num_envs_;
+    sample_size += int(rows.rows());
     mean /= sample_size;
-    for (int i = 0; i < num_envs_; i++) {
+    for (int i = 0; i < rows.rows(); i++) {
       for (int j = 0; j < data_size; j++) {
-        double temp = environments_[i]->getStepData()[j];
+        double temp = rows(i, j);
         squareSum[j] += temp * temp;
       }
     }
@@ -124,30 +336,201 @@ class VectorizedEnvironment {
     environments_[0]->getState(gc, gv);
   }
 
+  int getGcDim() { return environments_[0]->getGcDim(); }
+  int getGvDim() { return environments_[0]->getGvDim(); }
+
+  /// gc [num_envs x gcDim] and gv [num_envs x gvDim] of all environments, written in parallel into the caller's
+  /// row-major matrices in double precision
+  void getStates(Eigen::Ref<EigenDoubleRowMajorMat> gc, Eigen::Ref<EigenDoubleRowMajorMat> gv) {
+    RSFATAL_IF(asyncStepping_ > 0, "groups are being stepped asynchronously. recv() them first")
+    checkStateShape(gc.rows(), gc.cols(), gv.rows(), gv.cols());
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < num_envs_; i++)
+      environments_[i]->getGeneralizedState(gc.row(i).data(), gv.row(i).data());
+  }
+
+  /// moves the robot of every environment to the corresponding rows (see ENVIRONMENT::setGeneralizedState)
+  void setStates(const Eigen::Ref<const EigenDoubleRowMajorMat>& gc, const Eigen::Ref<const EigenDoubleRowMajorMat>& gv) {
+    RSFATAL_IF(asyncStepping_ > 0, "groups are being stepped asynchronously. recv() them first")
+    checkStateShape(gc.rows(), gc.cols(), gv.rows(), gv.cols());
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < num_envs_; i++)
+      environments_[i]->setGeneralizedState(gc.row(i).data(), gv.row(i).data());
+  }
+
+  /// binary snapshot of every environment (see ENVIRONMENT::getSnapshot)
+  std::vector<std::string> getSnapshots() {
+    RSFATAL_IF(asyncStepping_ > 0, "groups are being stepped asynchronously. recv() them first")
+    std::vector<std::string> blobs(num_envs_);
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < num_envs_; i++)
+      environments_[i]->getSnapshot(blobs[i]);
+    return blobs;
+  }
+
+  /// restores every environment. A single blob is restored into all environments (e.g., to fork rollouts)
+  void setSnapshots(const std::vector<std::string>& blobs) {
+    RSFATAL_IF(asyncStepping_ > 0, "groups are being stepped asynchronously. recv() them first")
+    RSFATAL_IF(blobs.size() != 1 && blobs.size() != size_t(num_envs_),
+               "expected 1 or "<<num_envs_<<" snapshots, got "<<blobs.size())
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < num_envs_; i++)
+      environments_[i]->setSnapshot(blobs[blobs.size() == 1 ? 0 : i]);
+  }
+
+  std::string getSnapshot(int id) {
+    RSFATAL_IF(asyncStepping_ > 0, "groups are being stepped asynchronously. recv() them first")
+    RSFATAL_IF(id < 0 || id >= num_envs_, "invalid environment id "<<id)
+    std::string blob;
+    environments_[id]->getSnapshot(blob);
+    return blob;
+  }
+
+  void setSnapshot(int id, const std::string& blob) {
+    RSFATAL_IF(asyncStepping_ > 0, "groups are being stepped asynchronously. recv() them first")
+    RSFATAL_IF(id < 0 || id >= num_envs_, "invalid environment id "<<id)
+    environments_[id]->setSnapshot(blob);
+  }
+
   void step(Eigen::Ref<EigenRowMajorMat> &action,
             Eigen::Ref<EigenVec> &reward,
             Eigen::Ref<EigenBoolVec> &done) {
-#pragma omp parallel for schedule(auto)
-    for (int i = 0; i < num_envs_; i++)
-      perAgentStep(i, action, reward, done, false);
+    stepAll(action, reward, done, false);
   }
 
   void step_visualize(Eigen::Ref<EigenRowMajorMat> &action,
                       Eigen::Ref<EigenVec> &reward,
                       Eigen::Ref<EigenBoolVec> &done) {
-#pragma omp parallel for schedule(auto)
-    for (int i = 0; i < num_envs_; i++)
-      perAgentStep(i, action, reward, done, true);
+    stepAll(action, reward, done, true);
+  }
+
+  /// Asynchronous stepping in groups of environments (cfg: async_groups), EnvPool-style. While the caller computes the
+  /// actions of one group, a background thread steps the groups whose actions were sent. asyncReset() resets all
+  /// environments and makes every group ready. recv() waits for the next ready group, in the order the groups were
+  /// sent, and returns its id. send() queues the actions of a received group. The synchronous step()/reset() must not
+  /// be used while a group is in flight. Asynchronous stepping is not logged and does not feed the frame stack or the
+  /// compact observations. If stepping a group fails, recv() rethrows the error and asyncReset() recovers all groups.
+  void asyncReset() {
+    std::unique_lock<std::mutex> lock(asyncMutex_);
+    RSFATAL_IF(asyncStepping_ > 0, "groups are being stepped asynchronously. recv() them first")
+    RSFATAL_IF(log_.logging(), "asynchronous stepping is not logged. stopLogging() first")
+    RSFATAL_IF(frameStack_.enabled() || compactOb_.enabled(),
+               "asynchronous stepping does not support frame_stack and compact_observation")
+    lock.unlock();
+    reset();
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < num_envs_; i++) {
+      auto &group = groups_[groupOf(i)];
+      environments_[i]->observe(group.ob.row(i - group.begin));
+    }
+    lock.lock();
+    ready_.clear();
+    for (int g = 0; g < int(groups_.size()); g++) {
+      groups_[g].reward.setZero();
+      groups_[g].done.setZero();
+      groups_[g].state = AsyncGroup::READY;
+      ready_.push_back(g);
+    }
+  }
+
+  /// Fills the first getGroupSize(group) rows of the outputs with the observations (normalized as in observe()),
+  /// rewards, dones and environment ids of the next ready group and returns the group id
+  int recv(Eigen::Ref<EigenRowMajorMat> &ob,
+           Eigen::Ref<EigenVec> &reward,
+           Eigen::Ref<EigenBoolVec> &done,
+           Eigen::Ref<EigenIntVec> envIds,
+           bool updateStatistics) {
+    std::unique_lock<std::mutex> lock(asyncMutex_);
+    RSFATAL_IF(ready_.empty() && asyncStepping_ == 0 && !asyncError_, "no group is in flight. Call asyncReset() or send() first")
+    asyncCv_.wait(lock, [&]() { return !ready_.empty() || asyncError_; });
+    if (asyncError_) std::rethrow_exception(std::exchange(asyncError_, nullptr));
+    /// the group stays ready if the outputs cannot hold it
+    const int g = ready_.front();
+    auto &group = groups_[g];
+    RSFATAL_IF(ob.rows() < group.count || ob.cols() != getObDim() || reward.size() < group.count ||
+               done.size() < group.count || envIds.size() < group.count, "the output buffers cannot hold group "<<g)
+    ready_.pop_front();
+    group.state = AsyncGroup::HELD;
+    lock.unlock();
+
+    ob.topRows(group.count) = group.ob;
+    reward.head(group.count) = group.reward;
+    done.head(group.count) = group.done;
+    for (int k = 0; k < group.count; k++)
+      envIds[k] = group.begin + k;
+    if (normalizeObservation_) {
+      Eigen::Ref<EigenRowMajorMat> rows = ob.topRows(group.count);
+      updateObservationStatisticsAndNormalize(rows, updateStatistics);
+    }
+    return g;
   }
 
+  /// queues the actions (getGroupSize(group) rows) of a group returned by recv() and returns immediately
+  void send(int group, Eigen::Ref<EigenRowMajorMat> &action) {
+    RSFATAL_IF(group < 0 || group >= int(groups_.size()), "invalid group "<<group)
+    auto &target = groups_[group];
+    RSFATAL_IF(action.rows() < target.count || action.cols() != getActionDim(), "action of group "<<group<<" has a wrong size")
+    std::unique_lock<std::mutex> lock(asyncMutex_);
+    /// the rewards of an arena are collected for all environments at once
+    RSFATAL_IF(controllerArena_, "asynchronous groups do not support controller_arena")
+    RSFATAL_IF(target.state != AsyncGroup::HELD, "group "<<group<<" was not received")
+    target.action = action.topRows(target.count);
+    target.state = AsyncGroup::STEPPING;
+    asyncStepping_++;
+    queued_.push_back(group);
+    if (!asyncThread_.joinable())
+      asyncThread_ = std::thread([this]() { asyncLoop(); });
+    lock.unlock();
+    asyncCv_.notify_all();
+  }
+
+  int getNumOfGroups() { return int(groups_.size()); }
+  int getGroupSize(int group) { return groups_[group].count; }
+
   void turnOnVisualization() { if(render_) environments_[0]->turnOnVisualization(); }
   void turnOffVisualization() { if(render_) environments_[0]->turnOffVisualization(); }
   void startRecordingVideo(const std::string& videoName) { if(render_) environments_[0]->startRecordingVideo(videoName); }
   void stopRecordingVideo() { if(render_) environments_[0]->stopRecordingVideo(); }
+
+  /// records environment id to a binary trajectory file that the <env>_replay executable plays back
+  void startRecordingTrajectory(const std::string& fileName, int id) {
+    RSFATAL_IF(id < 0 || id >= num_envs_, "invalid environment id "<<id)
+    environments_[id]->startRecordingTrajectory(fileName);
+  }
+
+  /// returns the number of records that were dropped because the disk could not keep up
+  uint64_t stopRecordingTrajectory(int id) {
+    RSFATAL_IF(id < 0 || id >= num_envs_, "invalid environment id "<<id)
+    return environments_[id]->stopRecordingTrajectory();
+  }
   void getObStatistics(Eigen::Ref<EigenVec> &mean, Eigen::Ref<EigenVec> &var, float &count) {
-    mean = obMean_; var = obVar_; count = obCount_; }
+    obNormalizer_.getStatistics(mean, var, count); }
   void setObStatistics(Eigen::Ref<EigenVec> &mean, Eigen::Ref<EigenVec> &var, float count) {
-    obMean_ = mean; obVar_ = var; obCount_ = count; }
+    obNormalizer_.setStatistics(mean, var, count); }
+  void getCriticObStatistics(Eigen::Ref<EigenVec> &mean, Eigen::Ref<EigenVec> &var, float &count) {
+    criticObNormalizer_.getStatistics(mean, var, count); }
+  void setCriticObStatistics(Eigen::Ref<EigenVec> &mean, Eigen::Ref<EigenVec> &var, float count) {
+    criticObNormalizer_.setStatistics(mean, var, count); }
+
+  /// the observation normalizer and, with a separate critic observation, the critic normalizer in one binary file
+  /// (see ObservationNormalizer::save)
+  void saveObStatistics(const std::string& fileName) {
+    std::vector<const ObservationNormalizer*> normalizers{&obNormalizer_};
+    if (separateCriticOb_) normalizers.push_back(&criticObNormalizer_);
+    ObservationNormalizer::save(fileName, normalizers);
+  }
+
+  /// returns whether the file also held critic statistics. Without them, the critic normalizer is left as it is
+  bool loadObStatistics(const std::string& fileName) {
+    auto normalizers = ObservationNormalizer::load(fileName);
+    RSFATAL_IF(normalizers.empty() || normalizers[0].obDim() != getObDim(), fileName<<" does not match the observation")
+    obNormalizer_ = normalizers[0];
+    if (separateCriticOb_ && normalizers.size() > 1) {
+      RSFATAL_IF(normalizers[1].obDim() != getCriticObDim(), fileName<<" does not match the critic observation")
+      criticObNormalizer_ = normalizers[1];
+    }
+    return normalizers.size() > 1;
+  }
 
   void setSeed(int seed) {
     int seed_inc = seed;
@@ -188,36 +571,138 @@ class VectorizedEnvironment {
   }
 
   int getObDim() { return ChildEnvironment::getObDim(); }
+  int getCriticObDim() { return separateCriticOb_ ? ChildEnvironment::getCriticObDim() : getObDim(); }
+  /// false if the critic observes the actor observation, so storage can keep a single buffer
+  bool hasSeparateCriticObservation() { return separateCriticOb_; }
   int getActionDim() { return ChildEnvironment::getActionDim(); }
   int getNumOfEnvs() { return num_envs_; }
 
+  /// phase -> {calls, total, p50, p99} in seconds. Empty unless compiled with RAISIMGYM_PROFILE
+  std::map<std::string, std::map<std::string, double>> getProfile() { return profiler::getProfile(); }
+  void resetProfile() { profiler::resetProfile(); }
+
+  /// worker thread, cpu and NUMA node of every thread and the NUMA node of the environments it steps
+  std::string getPlacementReport() {
+    const int threads = omp_get_max_threads();
+    std::vector<int> threadCpu(threads, -1), envThread(num_envs_, -1), envNode(num_envs_, -1);
+#pragma omp parallel
+    threadCpu[omp_get_thread_num()] = placement::currentCpu();
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < num_envs_; i++) {
+      envThread[i] = omp_get_thread_num();
+      envNode[i] = placement::nodeOfAddress(environments_[i]);
+    }
+
+    std::ostringstream report;
+    report << "[RAISIM_GYM] thread placement of " << num_envs_ << " environments on " << threads << " threads\n";
+    for (int t = 0; t < threads; t++) {
+      int first = -1, last = -1, local = 0, count = 0;
+      for (int i = 0; i < num_envs_; i++) {
+        if (envThread[i] != t) continue;
+        if (first < 0) first = i;
+        last = i;
+        count++;
+        local += envNode[i] >= 0 && envNode[i] == placement::nodeOfCpu(threadCpu[t]);
+      }
+      report << "  thread " << t << ": cpu " << threadCpu[t] << ", node " << placement::nodeOfCpu(threadCpu[t])
+             << ", envs " << first << "-" << last << " (" << local << "/" << count << " on the local node)\n";
+    }
+    return report.str();
+  }
+
+  /// records per-thread step/terminal/reset/observe events into ring buffers of eventsPerThread events
+  void startTracing(int eventsPerThread) { tracer_.start(THREAD_COUNT, size_t(std::max(eventsPerThread, 0))); }
+  void stopTracing() { tracer_.stop(); }
+  /// writes the recorded timeline as a Chrome trace JSON file (chrome://tracing or ui.perfetto.dev)
+  void dumpTrace(const std::string& fileName) { tracer_.dump(fileName); }
+
   ////// optional methods //////
   void curriculumUpdate() {
-    for (auto *env: environments_)
-      env->curriculumUpdate();
+    RSG_PROFILE_SCOPE(VEC_CURRICULUM)
+    /// every environment regenerates its terrain and refills its reset cache (cfg: reset_cache_size) in parallel
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < num_envs_; i++)
+      environments_[i]->curriculumUpdate();
   };
 
+  void updateObservationStatisticsAndNormalize(Eigen::Ref<EigenRowMajorMat> &ob, bool updateStatistics) {
+    obNormalizer_.updateAndNormalize(ob, updateStatistics);
+  }
+
  private:
+  void normalizeAndStack(Eigen::Ref<EigenRowMajorMat> &ob, bool updateStatistics) {
+    if (normalizeObservation_)
+      updateObservationStatisticsAndNormalize(ob, updateStatistics);
 
-  void updateObservationStatisticsAndNormalize(Eigen::Ref<EigenRowMajorMat> &ob, bool updateStatistics) {
-    if (updateStatistics) {
-      recentMean_ = ob.colwise().mean();
-      recentVar_ = (ob.rowwise() - recentMean_.transpose()).colwise().squaredNorm() / num_envs_;
+    /// before the frame stack, so that every consumer sees the 16-bit round trip
+    if (compactOb_.enabled()) compactOb_.quantize(ob);
 
-      delta_ = obMean_ - recentMean_;
-      for (int i = 0; i < getObDim(); i++)
-        delta_[i] = delta_[i] * delta_[i];
+    /// one frame per control step. Observing again before the next step replaces the newest frame
+    if (frameStack_.enabled()) {
+      frameStack_.push(ob, frameStackAdvance_);
+      frameStackAdvance_ = false;
+    }
+  }
 
-      float totCount = obCount_ + num_envs_;
+  /// a group of asyncReset/recv/send with its own buffers
+  struct AsyncGroup {
+    enum State { READY, HELD, STEPPING } state = READY;
+    int begin = 0, count = 0;
+    EigenRowMajorMat action, ob;
+    EigenVec reward;
+    EigenBoolVec done;
+  };
 
-      obMean_ = obMean_ * (obCount_ / totCount) + recentMean_ * (num_envs_ / totCount);
-      obVar_ = (obVar_ * obCount_ + recentVar_ * num_envs_ + delta_ * (obCount_ * num_envs_ / totCount)) / (totCount);
-      obCount_ = totCount;
+  void stepAll(Eigen::Ref<EigenRowMajorMat> &action,
+               Eigen::Ref<EigenVec> &reward,
+               Eigen::Ref<EigenBoolVec> &done,
+               bool visualize) {
+    RSFATAL_IF(asyncStepping_ > 0, "groups are being stepped asynchronously. recv() them first")
+    RSG_PROFILE_SCOPE(VEC_STEP)
+    {
+      Tracer::Scope batchTrace(tracer_, 0, Tracer::Event::BATCH_STEP, -1);
+      if (subStepMajor_) {
+        stepSubStepMajor(action, reward, done, visualize);
+      } else {
+#pragma omp parallel for schedule(static)
+        for (int i = 0; i < num_envs_; i++)
+          perAgentStep(i, action, reward, done, visualize);
+      }
     }
+    ChildEnvironment::collectRewards(environments_, reward);
+    recordEpisodes(reward, done);
+    if (log_.logging()) logStep(action, reward, done);
+    resetDoneAgents(done);
+    frameStackAdvance_ = true;
+  }
 
-#pragma omp parallel for schedule(auto)
-    for(int i=0; i<num_envs_; i++)
-      ob.row(i) = (ob.row(i) - obMean_.transpose()).template cwiseQuotient((obVar_ + epsilon).cwiseSqrt().transpose());
+  void checkStateShape(Eigen::Index gcRows, Eigen::Index gcCols, Eigen::Index gvRows, Eigen::Index gvCols) {
+    RSFATAL_IF(gcRows != num_envs_ || gcCols != getGcDim() || gvRows != num_envs_ || gvCols != getGvDim(),
+               "expected gc ["<<num_envs_<<" x "<<getGcDim()<<"] and gv ["<<num_envs_<<" x "<<getGvDim()<<"], got ["
+               <<gcRows<<" x "<<gcCols<<"] and ["<<gvRows<<" x "<<gvCols<<"]")
+  }
+
+  /// the state before the done environments are reset
+  void logStep(const Eigen::Ref<EigenRowMajorMat> &action, const Eigen::Ref<EigenVec> &reward,
+               const Eigen::Ref<EigenBoolVec> &done) {
+    RSG_PROFILE_SCOPE(VEC_LOG)
+    enum { GC = 0, GV, ACTION, REWARD, DONE, CONTACT };
+#pragma omp parallel for schedule(static)
+    for (int k = 0; k < int(logEnvIds_.size()); k++) {
+      const int i = logEnvIds_[k];
+      environments_[i]->getGeneralizedState(log_.row<double>(logColumns_[GC], k), log_.row<double>(logColumns_[GV], k));
+      Eigen::Map<EigenVec>(log_.row<float>(logColumns_[ACTION], k), action.cols()) = action.row(i).transpose();
+      *log_.row<float>(logColumns_[REWARD], k) = reward[i];
+      *log_.row<uint8_t>(logColumns_[DONE], k) = done[i];
+      environments_[i]->getContacts(log_.row<uint8_t>(logColumns_[CONTACT], k));
+    }
+    log_.endStep();
+  }
+
+  void recordEpisodes(const Eigen::Ref<EigenVec> &reward, const Eigen::Ref<EigenBoolVec> &done) {
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < num_envs_; i++)
+      episodeStats_.accumulate(omp_get_thread_num(), i, reward[i], done[i], environments_[i]->getStepData());
   }
 
   inline void perAgentStep(int agentId,
@@ -225,31 +710,197 @@ class VectorizedEnvironment {
                            Eigen::Ref<EigenVec> &reward,
                            Eigen::Ref<EigenBoolVec> &done,
                            bool visualize) {
-    reward[agentId] = environments_[agentId]->step(action.row(agentId), visualize);
+    {
+      Tracer::Scope trace(tracer_, omp_get_thread_num(), Tracer::Event::STEP, agentId);
+      reward[agentId] = environments_[agentId]->step(action.row(agentId), visualize);
+    }
+    terminalCheck(agentId, reward, done);
+  }
 
+  inline void terminalCheck(int agentId, Eigen::Ref<EigenVec> &reward, Eigen::Ref<EigenBoolVec> &done) {
     float terminalReward = 0;
-    done[agentId] = environments_[agentId]->isTerminalState(terminalReward);
+    {
+      Tracer::Scope trace(tracer_, omp_get_thread_num(), Tracer::Event::TERMINAL, agentId);
+      done[agentId] = environments_[agentId]->isTerminalState(terminalReward);
+    }
 
-    if (done[agentId]) {
-      environments_[agentId]->reset();
+    if (done[agentId])
       reward[agentId] += terminalReward;
+  }
+
+  /// Advances all environments one sub-step at a time. Between sub-steps, a serial pass counts the environments that
+  /// are still stepping (i.e., not terminated); while all of them are, their joint histories are shifted in one
+  /// batched pass over the controller arena (cfg: controller_arena)
+  void stepSubStepMajor(Eigen::Ref<EigenRowMajorMat> &action,
+                        Eigen::Ref<EigenVec> &reward,
+                        Eigen::Ref<EigenBoolVec> &done,
+                        bool visualize) {
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < num_envs_; i++)
+      environments_[i]->beginStep(action.row(i));
+
+    const int subSteps = environments_[0]->getSubStepCount();
+    int stepping = num_envs_;
+    for (int k = 0; k < subSteps && stepping > 0; k++) {
+      const bool historyShifted = stepping == num_envs_ && ChildEnvironment::shiftHistories(environments_);
+#pragma omp parallel for schedule(static)
+      for (int i = 0; i < num_envs_; i++) {
+        if (!environments_[i]->isSubStepping()) continue;
+        Tracer::Scope trace(tracer_, omp_get_thread_num(), Tracer::Event::STEP, i);
+        environments_[i]->subStep(historyShifted);
+      }
+
+      stepping = 0;
+      for (auto *env: environments_)
+        stepping += env->isSubStepping();
+    }
+
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < num_envs_; i++) {
+      reward[i] = float(environments_[i]->endStep(visualize));
+      terminalCheck(i, reward, done);
+    }
+  }
+
+  /// Resets the terminated agents after all agents stepped. The resets are spread over all threads instead of stalling
+  /// the threads that happened to step the terminated agents. With first touch, every agent is reset by the thread
+  /// that steps it instead, which keeps its memory on that thread's NUMA node
+  void resetDoneAgents(const Eigen::Ref<EigenBoolVec> &done) {
+    doneIds_.clear();
+    for (int i = 0; i < num_envs_; i++)
+      if (done[i]) doneIds_.push_back(i);
+    if (doneIds_.empty()) return;
+    if (frameStack_.enabled())
+      for (int id: doneIds_) frameStack_.markEpisodeStart(id);
+
+    RSG_PROFILE_SCOPE(VEC_RESET)
+    Tracer::Scope batchTrace(tracer_, 0, Tracer::Event::BATCH_RESET, -1);
+    if (firstTouch_) {
+#pragma omp parallel for schedule(static)
+      for (int i = 0; i < num_envs_; i++) {
+        if (!done[i]) continue;
+        Tracer::Scope trace(tracer_, omp_get_thread_num(), Tracer::Event::RESET, i);
+        environments_[i]->reset();
+      }
+    } else {
+#pragma omp parallel for schedule(dynamic)
+      for (int k = 0; k < int(doneIds_.size()); k++) {
+        Tracer::Scope trace(tracer_, omp_get_thread_num(), Tracer::Event::RESET, doneIds_[k]);
+        environments_[doneIds_[k]]->reset();
+      }
+    }
+  }
+
+  int groupOf(int envId) const {
+    int g = 0;
+    while (envId >= groups_[g].begin + groups_[g].count) g++;
+    return g;
+  }
+
+  /// the background thread of send(). It has its own OpenMP team
+  void asyncLoop() {
+    omp_set_num_threads(THREAD_COUNT);
+    std::unique_lock<std::mutex> lock(asyncMutex_);
+    while (true) {
+      asyncCv_.wait(lock, [&]() { return asyncStop_ || !queued_.empty(); });
+      if (asyncStop_) return;
+      const int g = queued_.front();
+      queued_.pop_front();
+      lock.unlock();
+      try {
+        stepGroup(groups_[g]);
+      } catch (...) {
+        lock.lock();
+        asyncError_ = std::current_exception();
+        /// the environments of the group are in an unknown state until asyncReset()
+        groups_[g].state = AsyncGroup::HELD;
+        asyncStepping_--;
+        asyncCv_.notify_all();
+        continue;
+      }
+      lock.lock();
+      groups_[g].state = AsyncGroup::READY;
+      ready_.push_back(g);
+      asyncStepping_--;
+      asyncCv_.notify_all();
     }
   }
 
+  /// A control step of one group: step, terminal check, reset of the terminated environments and observation.
+  /// Errors are rethrown so that asyncLoop() can hand them to recv()
+  void stepGroup(AsyncGroup &group) {
+    parallelForRethrow(group.count, [&](int k) {
+      auto *env = environments_[group.begin + k];
+      group.reward[k] = float(env->step(group.action.row(k), false));
+      float terminalReward = 0;
+      group.done[k] = env->isTerminalState(terminalReward);
+      if (group.done[k])
+        group.reward[k] += terminalReward;
+      episodeStats_.accumulate(omp_get_thread_num(), group.begin + k, group.reward[k], group.done[k], env->getStepData());
+    });
+
+    /// the terminated environments are reset by the threads that stepped them
+    parallelForRethrow(group.count, [&](int k) {
+      if (group.done[k]) environments_[group.begin + k]->reset();
+    });
+
+    parallelForRethrow(group.count, [&](int k) {
+      environments_[group.begin + k]->observe(group.ob.row(k));
+    });
+  }
+
+  /// body(k) for k in [0, count) in a static parallel loop. An exception must not leave an OpenMP region (the runtime
+  /// would terminate), so the first one is caught inside the loop and rethrown after it
+  template<typename Body>
+  static void parallelForRethrow(int count, const Body &body) {
+    std::exception_ptr error;
+#pragma omp parallel for schedule(static)
+    for (int k = 0; k < count; k++) {
+      try {
+        body(k);
+      } catch (...) {
+#pragma omp critical(raisimGymLoopError)
+        if (!error) error = std::current_exception();
+      }
+    }
+    if (error) std::rethrow_exception(error);
+  }
+
   std::vector<ChildEnvironment *> environments_;
+  std::vector<int> doneIds_;
+  EigenDoubleRowMajorMat stepDataRows_;
+  bool subStepMajor_ = false, controllerArena_ = false, firstTouch_ = false;
+
+  /// asynchronous groups
+  std::vector<AsyncGroup> groups_;
+  std::deque<int> queued_, ready_;
+  std::atomic<int> asyncStepping_{0};
+  std::mutex asyncMutex_;
+  std::condition_variable asyncCv_;
+  std::thread asyncThread_;
+  bool asyncStop_ = false;
+  std::exception_ptr asyncError_;
 
   int num_envs_ = 1;
   bool render_=false;
   std::string resourceDir_;
   Yaml::Node cfg_;
+  Tracer tracer_;
 
   /// observation running mean
   bool normalizeObservation_ = true;
-  EigenVec obMean_;
-  EigenVec obVar_;
-  float obCount_ = 1e-4;
-  EigenVec recentMean_, recentVar_, delta_;
-  EigenVec epsilon;
+  ObservationNormalizer obNormalizer_;
+  bool separateCriticOb_ = false;
+  ObservationNormalizer criticObNormalizer_;
+
+  FrameStack frameStack_;
+  bool frameStackAdvance_ = true;
+
+  CompactObservation compactOb_, compactCriticOb_;
+  EpisodeStatistics episodeStats_;
+
+  ColumnarLog log_;
+  std::vector<int> logColumns_, logEnvIds_;
 };
 
 class NormalDistribution {
@@ -0,0 +1,261 @@
+//----------------------------//
+// This file is part of RaiSim//
+// Copyright 2020, RaiSim Tech//
+//----------------------------//
+
+#include "Environment.hpp"
+#include "VectorizedEnvironment.hpp"
+#include "AppHelper.hpp"
+#include <chrono>
+#include <iomanip>
+#include <numeric>
+
+int THREAD_COUNT = 1;
+
+using namespace raisim;
+
+namespace {
+
+struct BenchOptions {
+  std::vector<int> numEnvs, numThreads;
+  std::vector<std::string> schedules; /// step_schedule values to compare
+  int warmupSteps = 50;
+  int steps = 1000;
+  int resetEvery = -1; /// control steps per episode. -1 uses max_time / control_dt like runner.py
+  int curriculumSamples = 3;
+  std::string output;
+  std::string trace; /// Chrome trace of the measured steps, written per configuration as <trace>_<envs>_<threads>.json
+};
+
+/// per-call wall-clock samples of one phase
+class PhaseSamples {
+ public:
+  template<typename Func>
+  void time(Func&& func) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    samples_.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  }
+
+  [[nodiscard]] double total() const { return std::accumulate(samples_.begin(), samples_.end(), 0.); }
+
+  void writeJson(std::ostream& os) {
+    std::sort(samples_.begin(), samples_.end());
+    os << "{\"calls\": " << samples_.size() << ", \"total_s\": " << total();
+    if (!samples_.empty()) {
+      os << ", \"mean_us\": " << total() / samples_.size() * 1e6
+         << ", \"p50_us\": " << percentile(0.5) * 1e6
+         << ", \"p90_us\": " << percentile(0.9) * 1e6
+         << ", \"p99_us\": " << percentile(0.99) * 1e6
+         << ", \"max_us\": " << samples_.back() * 1e6;
+    }
+    os << "}";
+  }
+
+ private:
+  /// nearest-rank percentile. samples_ must be sorted
+  [[nodiscard]] double percentile(double p) const {
+    size_t rank = size_t(std::ceil(p * double(samples_.size())));
+    return samples_[std::max<size_t>(rank, 1) - 1];
+  }
+
+  std::vector<double> samples_;
+};
+
+struct BenchResult {
+  int numEnvs, numThreads;
+  std::string schedule;
+  double stepsPerSecond, realTimeFactor;
+  std::vector<std::pair<std::string, PhaseSamples>> phases;
+  std::map<std::string, std::map<std::string, double>> profile; /// scoped timers, only with RAISIMGYM_PROFILE
+};
+
+std::vector<int> parseIntList(const std::string& str) {
+  std::vector<int> list;
+  std::stringstream ss(str);
+  std::string item;
+  while (std::getline(ss, item, ','))
+    list.push_back(std::stoi(item));
+  RSFATAL_IF(list.empty(), "empty list: "<<str)
+  return list;
+}
+
+std::vector<std::string> parseStringList(const std::string& str) {
+  std::vector<std::string> list;
+  std::stringstream ss(str);
+  std::string item;
+  while (std::getline(ss, item, ','))
+    list.push_back(item);
+  RSFATAL_IF(list.empty(), "empty list: "<<str)
+  return list;
+}
+
+BenchResult runConfiguration(const std::string& resourceDir, const std::string& baseCfg,
+                             int numEnvs, int numThreads, const std::string& schedule, const BenchOptions& opt) {
+  Yaml::Node cfg;
+  Yaml::Parse(cfg, baseCfg);
+  cfg["num_envs"] = std::to_string(numEnvs);
+  cfg["num_threads"] = std::to_string(numThreads);
+  cfg["render"] = "False";
+  cfg["step_schedule"] = schedule;
+  std::string cfgStr;
+  Yaml::Serialize(cfg, cfgStr);
+
+  double controlDt, maxTime;
+  int seed;
+  READ_YAML(double, controlDt, cfg["control_dt"])
+  READ_YAML(double, maxTime, cfg["max_time"])
+  READ_YAML(int, seed, cfg["seed"])
+  const int resetEvery = opt.resetEvery > 0 ? opt.resetEvery : int(std::floor(maxTime / controlDt));
+
+  VectorizedEnvironment<ENVIRONMENT> vecEnv(resourceDir, cfgStr);
+  vecEnv.init();
+
+  EigenRowMajorMat observation(numEnvs, vecEnv.getObDim());
+  EigenRowMajorMat action(numEnvs, vecEnv.getActionDim());
+  EigenVec reward(numEnvs, 1);
+  EigenBoolVec dones(numEnvs, 1);
+
+  Eigen::Ref<EigenRowMajorMat> ob_ref(observation), action_ref(action);
+  Eigen::Ref<EigenVec> reward_ref(reward);
+  Eigen::Ref<EigenBoolVec> dones_ref(dones);
+
+  /// the same action sequence for every run of a configuration
+  std::mt19937 actionGen(seed);
+  std::normal_distribution<float> actionDist(0.f, 1.f);
+  auto sampleAction = [&]() { for (int i = 0; i < action.size(); i++) action.data()[i] = actionDist(actionGen); };
+
+  vecEnv.reset();
+  for (int i = 0; i < opt.warmupSteps; i++) {
+    vecEnv.observe(ob_ref, true);
+    sampleAction();
+    vecEnv.step(action_ref, reward_ref, dones_ref);
+  }
+
+  BenchResult result;
+  result.numEnvs = numEnvs;
+  result.numThreads = numThreads;
+  result.schedule = schedule;
+  PhaseSamples step, observe, normalize, reset, curriculum;
+
+  vecEnv.reset();
+  vecEnv.resetProfile();
+  if (!opt.trace.empty())
+    vecEnv.startTracing(1 << 16);
+  for (int i = 0; i < opt.steps; i++) {
+    if (i > 0 && i % resetEvery == 0)
+      reset.time([&]() { vecEnv.reset(); });
+    observe.time([&]() { vecEnv.observeRaw(ob_ref); });
+    normalize.time([&]() { vecEnv.updateObservationStatisticsAndNormalize(ob_ref, true); });
+    sampleAction();
+    step.time([&]() { vecEnv.step(action_ref, reward_ref, dones_ref); });
+  }
+
+  if (!opt.trace.empty()) {
+    vecEnv.stopTracing();
+    vecEnv.dumpTrace(opt.trace + "_" + std::to_string(numEnvs) + "_" + std::to_string(numThreads) +
+                     (opt.schedules.size() > 1 ? "_" + schedule : "") + ".json");
+  }
+
+  for (int i = 0; i < opt.curriculumSamples; i++)
+    curriculum.time([&]() { vecEnv.curriculumUpdate(); });
+
+  const double loopTime = step.total() + observe.total() + normalize.total() + reset.total();
+  result.stepsPerSecond = double(numEnvs) * opt.steps / loopTime;
+  result.realTimeFactor = result.stepsPerSecond * controlDt;
+  result.profile = vecEnv.getProfile();
+  result.phases = {{"step", step}, {"observe", observe}, {"normalize", normalize},
+                   {"reset", reset}, {"curriculum", curriculum}};
+  return result;
+}
+
+void writeJson(std::ostream& os, const std::string& cfgFile, const BenchOptions& opt, std::vector<BenchResult>& results) {
+  os << std::setprecision(9);
+  os << "{\n  \"benchmark\": \"" << RSG_MAKE_STR(RAISIMGYM_TORCH_ENV_NAME) << "\",\n"
+     << "  \"cfg\": \"" << cfgFile << "\",\n"
+     << "  \"warmup_steps\": " << opt.warmupSteps << ",\n"
+     << "  \"steps\": " << opt.steps << ",\n"
+     << "  \"results\": [\n";
+  for (size_t r = 0; r < results.size(); r++) {
+    auto& res = results[r];
+    os << "    {\"num_envs\": " << res.numEnvs << ", \"num_threads\": " << res.numThreads
+       << ", \"step_schedule\": \"" << res.schedule << "\""
+       << ", \"steps_per_second\": " << res.stepsPerSecond << ", \"real_time_factor\": " << res.realTimeFactor
+       << ",\n     \"phases\": {";
+    for (size_t p = 0; p < res.phases.size(); p++) {
+      os << (p == 0 ? "" : ",") << "\n       \"" << res.phases[p].first << "\": ";
+      res.phases[p].second.writeJson(os);
+    }
+    os << "}";
+    if (!res.profile.empty()) {
+      os << ",\n     \"profile\": {";
+      for (auto it = res.profile.begin(); it != res.profile.end(); it++) {
+        os << (it == res.profile.begin() ? "" : ",") << "\n       \"" << it->first << "\": {";
+        for (auto jt = it->second.begin(); jt != it->second.end(); jt++)
+          os << (jt == it->second.begin() ? "" : ", ") << "\"" << jt->first << "\": " << jt->second;
+        os << "}";
+      }
+      os << "}";
+    }
+    os << "}" << (r + 1 == results.size() ? "" : ",") << "\n";
+  }
+  os << "  ]\n}\n";
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  RSFATAL_IF(argc < 3, "got "<<argc<<" arguments. "<<"This executable takes at least two arguments: 1. resource directory, 2. configuration file\n"
+      <<"options: --envs 100,400 --threads 1,30 --warmup 50 --steps 1000 --reset-every N --curriculum-samples 3 --output bench.json --trace bench_trace\n"
+      <<"         --schedules env_major,substep_major")
+
+  std::string resourceDir(argv[1]), cfgFile(argv[2]);
+  std::string config_str = readEnvironmentConfig(cfgFile);
+
+  Yaml::Node config;
+  Yaml::Parse(config, config_str);
+
+  BenchOptions opt;
+  opt.numEnvs = {config["num_envs"].template As<int>()};
+  opt.numThreads = {config["num_threads"].template As<int>()};
+  opt.schedules = {config["step_schedule"].template As<std::string>("env_major")};
+
+  for (int i = 3; i < argc; i++) {
+    std::string arg(argv[i]);
+    RSFATAL_IF(i + 1 >= argc, "missing value for "<<arg)
+    std::string value(argv[++i]);
+    if (arg == "--envs") opt.numEnvs = parseIntList(value);
+    else if (arg == "--threads") opt.numThreads = parseIntList(value);
+    else if (arg == "--warmup") opt.warmupSteps = std::stoi(value);
+    else if (arg == "--steps") opt.steps = std::stoi(value);
+    else if (arg == "--reset-every") opt.resetEvery = std::stoi(value);
+    else if (arg == "--curriculum-samples") opt.curriculumSamples = std::stoi(value);
+    else if (arg == "--output") opt.output = value;
+    else if (arg == "--trace") opt.trace = value;
+    else if (arg == "--schedules") opt.schedules = parseStringList(value);
+    else RSFATAL("unknown option "<<arg)
+  }
+
+  std::vector<BenchResult> results;
+  for (int numEnvs: opt.numEnvs) {
+    for (int numThreads: opt.numThreads) {
+      for (auto& schedule: opt.schedules) {
+        results.push_back(runConfiguration(resourceDir, config_str, numEnvs, numThreads, schedule, opt));
+        std::cerr << "[RAISIM_GYM] num_envs " << std::setw(5) << numEnvs
+                  << " | num_threads " << std::setw(3) << numThreads
+                  << " | " << std::setw(13) << schedule
+                  << " | " << std::setw(10) << std::fixed << std::setprecision(0) << results.back().stepsPerSecond << " steps/s"
+                  << " | real time factor " << std::setw(8) << results.back().realTimeFactor << std::endl;
+      }
+    }
+  }
+
+  if (opt.output.empty()) {
+    writeJson(std::cout, cfgFile, opt, results);
+  } else {
+    std::ofstream file(opt.output);
+    RSFATAL_IF(!file.is_open(), "cannot open "<<opt.output)
+    writeJson(file, cfgFile, opt, results);
+  }
+  return 0;
+}
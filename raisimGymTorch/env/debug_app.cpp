@@ -5,20 +5,12 @@
 
 #include "Environment.hpp"
 #include "VectorizedEnvironment.hpp"
-#include <chrono>
+#include "AppHelper.hpp"
 
 int THREAD_COUNT = 1;
 
 using namespace raisim;
 
-void print_timediff(const char *prefix, int loopCount,
-                    const std::chrono::steady_clock::time_point &start,
-                    const std::chrono::steady_clock::time_point &end) {
-  double milliseconds = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
-  std::cout<<milliseconds<<" microseconds"<<std::endl;
-  printf("The simulation of %s is running at: %lf MHz\n", prefix, loopCount / milliseconds);
-}
-
 inline std::string loadResource (const std::string& file) {
   std::string urdfPath(__FILE__);
   while (urdfPath.back() != raisim::Path::separator()[0])
@@ -31,26 +23,7 @@ int main(int argc, char *argv[]) {
   RSFATAL_IF(argc != 3, "got "<<argc<<" arguments. "<<"This executable takes three arguments: 1. resource directory, 2. configuration file")
 
   std::string resourceDir(argv[1]), cfgFile(argv[2]);
-  std::ifstream myfile (cfgFile);
-  std::string config_str, line;
-  bool escape = false;
-
-  while (std::getline(myfile, line)) {
-    if(line == "environment:") {
-      escape = true;
-      while (std::getline(myfile, line)) {
-        if(line.substr(0, 2) == "  ")
-          config_str += line.substr(2) + "\n";
-        else if (line[0] == '#')
-          continue;
-        else
-          break;
-      }
-    }
-    if(escape)
-      break;
-  }
-  config_str.pop_back();
+  std::string config_str = readEnvironmentConfig(cfgFile);
   VectorizedEnvironment<ENVIRONMENT> vecEnv(resourceDir, config_str);
   vecEnv.init();
 
@@ -14,6 +14,11 @@
 // raisimGymTorch include
 #include "../../Yaml.hpp"
 #include "../../BasicEigenTypes.hpp"
+#include "../../Profiler.hpp"
+#include "../../ResetStateBank.hpp"
+#include "../../Snapshot.hpp"
+#include "../../StartStateBuffer.hpp"
+#include "../../TrajectoryRecorder.hpp"
 #include "RaiboController.hpp"
 #include "RandomHeightMapGenerator.hpp"
 
@@ -52,7 +57,7 @@ class ENVIRONMENT {
 
     /// create heightmap
     groundType_ = (id+3) % 4;
-    heightMap_ = terrainGenerator_.generateTerrain(&world_, RandomHeightMapGenerator::GroundType(groundType_), curriculumFactor_, gen_, uniDist_);
+    generateTerrain();
 
     /// get robot data
     gcDim_ = int(raibo_->getGeneralizedCoordinateDim());
@@ -65,11 +70,23 @@ class ENVIRONMENT {
     gc_init_from_.setZero(gcDim_);
     gv_init_from_.setZero(gvDim_);
 
+    /// states visited during training that resets can start from
+    startStateRecordInterval_ = cfg["start_state_buffer"]["record_every_n"].template As<int>(40);
+    startStateBuffer_.resize(cfg["start_state_buffer"]["capacity"].template As<int>(16), gcDim_, gvDim_);
+    startStateSources_ = {&startStateBuffer_};
+
+    /// number of reset states precomputed at every curriculum update that resets draw from at random
+    /// (0: every reset samples a new state)
+    resetCacheSize_ = cfg["reset_cache_size"].template As<int>(0);
+
+    /// initial states generated offline by the <env>_reset_bank tool (empty: sample them at reset)
+    const std::string resetBankFile = cfg["reset_bank"].template As<std::string>("");
+    if (!resetBankFile.empty()) openResetBank(resetBankFile);
+
     /// this is nominal configuration of anymal
     nominalJointConfig_<< 0, 0.56, -1.12, 0, 0.56, -1.12, 0, 0.56, -1.12, 0, 0.56, -1.12;
     gc_init_.head(7) << 0, 0, 0.54, 1.0, 0.0, 0.0, 0.0;
     gc_init_.tail(12) = nominalJointConfig_;
-    gc_init_from_ = gc_init_;
     raibo_->setGeneralizedForce(Eigen::VectorXd::Zero(gvDim_));
 
     // Reward coefficients
@@ -85,7 +102,7 @@ class ENVIRONMENT {
   }
 
   ~ENVIRONMENT() { if (server_) server_->killServer(); }
-  void init () { }
+  void init () { fillResetCache(); }
   void close () { }
   void setSimulationTimeStep(double dt) { controller_.setSimDt(dt); };
   void setControlTimeStep(double dt) { controller_.setConDt(dt); };
@@ -94,9 +111,71 @@ class ENVIRONMENT {
   void startRecordingVideo(const std::string& videoName ) { server_->startRecordingVideo(videoName); }
   void stopRecordingVideo() { server_->stopRecordingVideo(); }
   const std::vector<std::string>& getStepDataTag() { return controller_.getStepDataTag(); }
-  const Eigen::VectorXd& getStepData() { return controller_.getStepData(); }
+  const Eigen::Map<Eigen::VectorXd>& getStepData() { return controller_.getStepData(); }
+
+  /// initial state of an episode
+  struct ResetState {
+    Eigen::VectorXd gc, gv;
+    Eigen::Vector3d command;
+  };
 
   void reset() {
+    RSG_PROFILE_SCOPE(ENV_RESET)
+    if (resetCache_.empty()) {
+      sampleResetState(resetState_);
+      applyResetState(resetState_);
+    } else {
+      const size_t size = resetCache_.size();
+      applyResetState(resetCache_[std::min(size_t(uniDist_(gen_) * double(size)), size - 1)]);
+    }
+    if (recorder_.recording()) recorder_.episode(recordedSteps_);
+  }
+
+  /// Draws a random initial state. The robot is moved to compute the terrain height under the feet,
+  /// so its state is only meaningful again after applyResetState() or setState()
+  void sampleResetState(ResetState& state) {
+    bool fromBank = resetBank_.loaded();
+    if (fromBank)
+      drawBankState(state);
+    else
+      sampleInitialState(state, curriculumFactor_);
+
+    // randomly initialize from previous trajectories
+    if(uniDist_(gen_) < 0.25) {
+      const auto* source = startStateSources_[std::min(size_t(uniDist_(gen_) * startStateSources_.size()), startStateSources_.size() - 1)];
+      const int size = source->size();
+      if (size > 0 && source->load(std::min(int(uniDist_(gen_) * size), size - 1), gc_init_from_, gv_init_from_)) {
+        gc_init_ = gc_init_from_;
+        gv_init_ = gv_init_from_;
+        fromBank = false;
+      }
+    }
+
+    // keep one foot on the terrain
+    double maxNecessaryShift = -1e20; /// some arbitrary high negative value
+    if (fromBank) {
+      /// the bank stores the foot positions relative to the base, so the robot does not have to be moved
+      for (int i = 0; i < 4; i++) {
+        const Eigen::Vector3d footPosition = gc_init_.head(3) + bankFootOffsets_.col(i);
+        maxNecessaryShift = std::max(maxNecessaryShift, heightMap_->getHeight(footPosition[0], footPosition[1]) - footPosition[2]);
+      }
+    } else {
+      raibo_->setGeneralizedCoordinate(gc_init_);
+      raisim::Vec<3> footPosition;
+      for(auto& foot: footFrameIndicies_) {
+        raibo_->getFramePosition(foot, footPosition);
+        double terrainHeightMinusFootPosition = heightMap_->getHeight(footPosition[0], footPosition[1]) - footPosition[2];
+        maxNecessaryShift = maxNecessaryShift > terrainHeightMinusFootPosition ? maxNecessaryShift : terrainHeightMinusFootPosition;
+      }
+    }
+    gc_init_[2] += maxNecessaryShift + 0.07;
+    state.gc = gc_init_;
+    state.gv = gv_init_;
+  }
+
+  /// Samples the terrain-independent part of an initial state into gc_init_, gv_init_ and state.command.
+  /// The velocities are scaled by velocityScale (the curriculum factor)
+  void sampleInitialState(ResetState& state, double velocityScale) {
     // orientation
     raisim::Mat<3,3> rotMat, yawRot, pitchRollMat;
     raisim::Vec<4> quaternion;
@@ -118,99 +197,140 @@ class ENVIRONMENT {
 
     // command
 //    const bool standingMode = normDist_(gen_) > 1.7;
-    const bool standingMode = false;
-    controller_.setStandingMode(standingMode);
     const double angle = 2. * (uniDist_(gen_) - 0.5) * M_PI;
     const double heading = 2. * (uniDist_(gen_) - 0.5) * M_PI;
-    command_ << 5.0 * cos(angle), 5.0 * sin(angle), heading;
+    state.command << 5.0 * cos(angle), 5.0 * sin(angle), heading;
 
     /// randomize generalized velocities
     raisim::Vec<3> bodyVel_b, bodyVel_w;
-    bodyVel_b[0] = 0.6 * normDist_(gen_) * curriculumFactor_;
-    bodyVel_b[1] = 0.6 * normDist_(gen_) * curriculumFactor_;
-    bodyVel_b[2] = 0.3 * normDist_(gen_) * curriculumFactor_;
+    bodyVel_b[0] = 0.6 * normDist_(gen_) * velocityScale;
+    bodyVel_b[1] = 0.6 * normDist_(gen_) * velocityScale;
+    bodyVel_b[2] = 0.3 * normDist_(gen_) * velocityScale;
     raisim::matvecmul(rotMat, bodyVel_b, bodyVel_w);
 
     // base angular velocities (just define this in the world frame since it is isometric)
     raisim::Vec<3> bodyAng_w;
-    for(int i=0; i<3; i++) bodyAng_w[i] = 0.4 * normDist_(gen_) * curriculumFactor_;
+    for(int i=0; i<3; i++) bodyAng_w[i] = 0.4 * normDist_(gen_) * velocityScale;
 
     // joint velocities
     Eigen::VectorXd jointVel(12);
-    for(int i=0; i<12; i++) jointVel[i] = 3. * normDist_(gen_) * curriculumFactor_;
+    for(int i=0; i<12; i++) jointVel[i] = 3. * normDist_(gen_) * velocityScale;
 
     // combine
     gv_init_ << bodyVel_w.e(), bodyAng_w.e(), jointVel;
+  }
 
-    // randomly initialize from previous trajectories
-    if(uniDist_(gen_) < 0.25) {
-      gc_init_ = gc_init_from_;
-      gv_init_ = gv_init_from_;
-      gc_init_.head(2).setZero();
-    }
-    raibo_->setGeneralizedCoordinate(gc_init_);
-
-    // keep one foot on the terrain
-    raisim::Vec<3> footPosition;
-    double maxNecessaryShift = -1e20; /// some arbitrary high negative value
-    for(auto& foot: footFrameIndicies_) {
-      raibo_->getFramePosition(foot, footPosition);
-      double terrainHeightMinusFootPosition = heightMap_->getHeight(footPosition[0], footPosition[1]) - footPosition[2];
-      maxNecessaryShift = maxNecessaryShift > terrainHeightMinusFootPosition ? maxNecessaryShift : terrainHeightMinusFootPosition;
-    }
-    gc_init_[2] += maxNecessaryShift + 0.07;
-
-    /// set the state
-    raibo_->setState(gc_init_, gv_init_); /// set it again to ensure that foot is in contact
+  void applyResetState(const ResetState& state) {
+    const bool standingMode = false;
+    controller_.setStandingMode(standingMode);
+    command_ = state.command;
+    raibo_->setState(state.gc, state.gv); /// set it again to ensure that foot is in contact
     controller_.reset(gen_, normDist_);
     controller_.updateStateVariables();
   }
 
+  /// env.step in the profile is the sum of beginStep(), subStep() and endStep(), so it is comparable across the
+  /// step schedules
   double step(const Eigen::Ref<EigenVec>& action, bool visualize) {
+    beginStep(action);
+    while (isSubStepping())
+      subStep();
+    return endStep(visualize);
+  }
+
+  /// A control step split into phases so that VectorizedEnvironment can advance all environments one sub-step at a
+  /// time (step_schedule: substep_major): beginStep(), subStep() while isSubStepping(), endStep()
+  void beginStep(const Eigen::Ref<EigenVec>& action) {
+    RSG_PROFILE_PART(stepTicks_)
     /// action scaling
     controller_.advance(&world_, action, curriculumFactor_);
+    subStepsTaken_ = 0;
+    stepTerminal_ = false;
+  }
 
-    float dummy;
-    int howManySteps;
-
-    for(howManySteps = 0; howManySteps< int(control_dt_ / simulation_dt_ + 1e-10); howManySteps++) {
-      subStep();
+  /// false once all sub-steps of the control step ran or the episode terminated
+  [[nodiscard]] bool isSubStepping() const {
+    return !stepTerminal_ && subStepsTaken_ < getSubStepCount();
+  }
 
-      if(isTerminalState(dummy)) {
-        howManySteps++;
-        break;
-      }
+  [[nodiscard]] int getSubStepCount() const { return int(control_dt_ / simulation_dt_ + 1e-10); }
+
+  /// historyShifted: the joint histories were already shifted by shiftHistories()
+  void subStep(bool historyShifted = false) {
+    RSG_PROFILE_PART(stepTicks_)
+    RSG_PROFILE_SCOPE(ENV_SUBSTEP)
+    controller_.updateHistory(historyShifted);
+    {
+      RSG_PROFILE_SCOPE(ENV_PHYSICS)
+      world_.integrate1();
+      world_.integrate2();
+    }
+    {
+      RSG_PROFILE_SCOPE(ENV_STATE_UPDATE)
+      controller_.updateStateVariables();
+    }
+    {
+      RSG_PROFILE_SCOPE(ENV_REWARD)
+      controller_.accumulateRewards(curriculumFactor_, command_);
     }
-    return controller_.getRewardSum(visualize);
+    /// the terminal flag is a byproduct of the contact pass in updateStateVariables()
+    float dummy;
+    subStepsTaken_++;
+    stepTerminal_ = controller_.isTerminalState(dummy);
   }
 
-  void subStep() {
-    controller_.updateHistory();
-    world_.integrate1();
-    world_.integrate2();
-    controller_.updateStateVariables();
-    controller_.accumulateRewards(curriculumFactor_, command_);
-
-    if(uniDist_(gen_) < 0.005) {
-      raibo_->getState(gc_init_from_, gv_init_from_);
-      gc_init_from_[0] = 0.;
-      gc_init_from_[1] = 0.;
+  double endStep(bool visualize) {
+    double reward;
+    {
+      RSG_PROFILE_PART(stepTicks_)
+      /// record a start state every startStateRecordInterval_ control steps
+      if (++controlStepsSinceRecord_ >= startStateRecordInterval_ && !stepTerminal_) {
+        controlStepsSinceRecord_ = 0;
+        raibo_->getState(gc_init_from_, gv_init_from_);
+        gc_init_from_.head(2).setZero();
+        startStateBuffer_.record(gc_init_from_, gv_init_from_);
+      }
+      if (recorder_.recording()) recorder_.frame(recordedSteps_++, raibo_->getGeneralizedCoordinate().e());
+      /// with a shared controller arena, the rewards of all environments are summed by collectRewards()
+      reward = controllerArena_ ? 0.f : controller_.getRewardSum(visualize);
     }
+    RSG_PROFILE_COMMIT(ENV_STEP, stepTicks_)
+    return reward;
   }
 
   void observe(Eigen::Ref<EigenVec> ob) {
+    RSG_PROFILE_SCOPE(ENV_OBSERVE)
     controller_.updateObservation(true, command_, heightMap_, gen_, normDist_);
     controller_.getObservation(obScaled_);
     ob = obScaled_.cast<float>();
   }
 
+  /// the actor observation and the critic observation: the actor observation followed by the privileged
+  /// observation of the controller, the curriculum factor and the ground type (one-hot)
+  void observe(Eigen::Ref<EigenVec> ob, Eigen::Ref<EigenVec> criticOb) {
+    observe(ob);
+    RSG_PROFILE_SCOPE(ENV_CRITIC_OBSERVE)
+    constexpr int privilegedDim = RaiboController::getPrivilegedObDim();
+    privilegedOb_.resize(privilegedDim);
+    controller_.getPrivilegedObservation(privilegedOb_, heightMap_);
+    criticOb.head(getObDim()) = ob;
+    criticOb.segment(getObDim(), privilegedDim) = privilegedOb_.cast<float>();
+    criticOb[getObDim() + privilegedDim] = float(curriculumFactor_);
+    criticOb.tail(4).setZero();
+    criticOb[getCriticObDim() - 4 + groundType_] = 1.f;
+  }
+
   bool isTerminalState(float& terminalReward) {
+    RSG_PROFILE_SCOPE(ENV_TERMINAL)
     return controller_.isTerminalState(terminalReward);
   }
 
   void setSeed(int seed) {
     gen_.seed(seed);
+    normDist_.reset();
+    uniDist_.reset();
     terrainGenerator_.setSeed(seed);
+    if (!resetCache_.empty()) fillResetCache();
   }
 
   void curriculumUpdate() {
@@ -218,7 +338,89 @@ class ENVIRONMENT {
     curriculumFactor_ = std::pow(curriculumFactor_, curriculumDecayFactor_);
     /// create heightmap
     world_.removeObject(heightMap_);
-    heightMap_ = terrainGenerator_.generateTerrain(&world_, RandomHeightMapGenerator::GroundType(groundType_), curriculumFactor_, gen_, uniDist_);
+    generateTerrain();
+    /// the cached states were sampled on the old terrain and curriculum factor
+    fillResetCache();
+  }
+
+  /// Full state of the environment: robot gc/gv, controller state and history, command, terrain
+  /// (ground type, curriculum factor, seed) and random number generators.
+  /// The physics engine's internal caches (e.g., contact solver warm start) are not part of the snapshot.
+  void getSnapshot(std::string& blob) {
+    SnapshotWriter writer(blob, snapshotVersion_, getObDim());
+    Eigen::VectorXd gc(gcDim_), gv(gvDim_);
+    raibo_->getState(gc, gv);
+    writer.writeVector(gc);
+    writer.writeVector(gv);
+    writer.writeVector(command_);
+    writer.write(int32_t(controlStepsSinceRecord_));
+    startStateBuffer_.writeSnapshot(writer);
+    writer.write(int32_t(resetCache_.size()));
+    for (auto& state: resetCache_) {
+      writer.writeVector(state.gc);
+      writer.writeVector(state.gv);
+      writer.writeVector(state.command);
+    }
+    writer.write(curriculumFactor_);
+    writer.write(int32_t(groundType_));
+    writer.write(int32_t(terrainSeed_));
+    writer.write(int32_t(terrainGenerator_.getSeed()));
+    writer.writeStreamable(gen_);
+    writer.writeStreamable(normDist_);
+    writer.writeStreamable(uniDist_);
+    controller_.writeSnapshot(writer);
+  }
+
+  void setSnapshot(const std::string& blob) {
+    SnapshotReader reader(blob, snapshotVersion_, getObDim());
+    Eigen::VectorXd gc(gcDim_), gv(gvDim_);
+    reader.readVector(gc);
+    reader.readVector(gv);
+    reader.readVector(command_);
+    controlStepsSinceRecord_ = reader.read<int32_t>();
+    startStateBuffer_.readSnapshot(reader);
+    RSFATAL_IF(reader.read<int32_t>() != int(resetCache_.size()), "the snapshot has a different reset cache size")
+    for (auto& state: resetCache_) {
+      reader.readVector(state.gc);
+      reader.readVector(state.gv);
+      reader.readVector(state.command);
+    }
+    const double curriculumFactor = reader.read<double>();
+    const int groundType = reader.read<int32_t>();
+    const int terrainSeed = reader.read<int32_t>();
+    const int nextTerrainSeed = reader.read<int32_t>();
+    reader.readStreamable(gen_);
+    reader.readStreamable(normDist_);
+    reader.readStreamable(uniDist_);
+
+    /// the terrain is regenerated only if it differs
+    if (curriculumFactor != curriculumFactor_ || groundType != groundType_ || terrainSeed != terrainSeed_) {
+      curriculumFactor_ = curriculumFactor;
+      groundType_ = groundType;
+      terrainGenerator_.setSeed(terrainSeed);
+      world_.removeObject(heightMap_);
+      generateTerrain();
+    }
+    terrainGenerator_.setSeed(nextTerrainSeed);
+
+    raibo_->setState(gc, gv);
+    controller_.readSnapshot(reader);
+    RSFATAL_IF(!reader.finished(), "unexpected trailing data in the snapshot")
+  }
+
+  /// writes the robot state of every control step, the terrain and the episode boundaries to fileName in the
+  /// background, without a RaisimServer (see TrajectoryRecorder). Play it back with the <env>_replay executable
+  void startRecordingTrajectory(const std::string& fileName) {
+    recorder_.start(fileName, gcDim_, control_dt_);
+    recordedSteps_ = 0;
+    recordTerrain();
+    recorder_.episode(recordedSteps_);
+  }
+
+  /// returns the number of records dropped because the disk could not keep up
+  uint64_t stopRecordingTrajectory() {
+    recorder_.stop();
+    return recorder_.dropped();
   }
 
   void moveControllerCursor(Eigen::Ref<EigenVec> pos) {
@@ -230,15 +432,116 @@ class ENVIRONMENT {
     commandSphere_->setPosition(command_);
   }
 
+  /// moves the per-step controller state of all environments into one arena (cfg: controller_arena). Every column
+  /// is first written by the thread that steps the environment (same static schedule), so with first touch it is
+  /// placed on that thread's NUMA node
+  static void bindControllerArena(const std::vector<ENVIRONMENT*>& environments) {
+    auto arena = std::make_shared<RaiboController::StateArena>();
+    arena->allocate(int(environments.size()));
+#pragma omp parallel for schedule(static)
+    for (int i = 0; i < int(environments.size()); i++) {
+      environments[i]->controller_.bindArena(*arena, i);
+      environments[i]->controllerArena_ = arena;
+    }
+  }
+
+  /// adds the rewards of the last control step of all environments in one batched pass.
+  /// Returns false (and does nothing) if the environments are not bound to an arena
+  static bool collectRewards(const std::vector<ENVIRONMENT*>& environments, Eigen::Ref<EigenVec> reward) {
+    if (environments.empty() || !environments[0]->controllerArena_) return false;
+    environments[0]->controllerArena_->collectRewards(reward);
+    return true;
+  }
+
+  /// shifts the joint histories of all environments in one pass over the controller arena, ahead of
+  /// subStep(true). Returns false (and does nothing) if the environments are not bound to an arena
+  static bool shiftHistories(const std::vector<ENVIRONMENT*>& environments) {
+    if (environments.empty() || !environments[0]->controllerArena_) return false;
+    environments[0]->controllerArena_->shiftHistories();
+    return true;
+  }
+
+  /// lets resets start from states recorded by other environments as well
+  [[nodiscard]] const StartStateBuffer* getStartStateBuffer() const { return &startStateBuffer_; }
+  void setStartStateSources(const std::vector<const StartStateBuffer*>& sources) { startStateSources_ = sources; }
+
   static constexpr int getObDim() { return RaiboController::getObDim(); }
+  static constexpr int getCriticObDim() { return RaiboController::getObDim() + RaiboController::getPrivilegedObDim() + 1 + 4; }
   static constexpr int getActionDim() { return RaiboController::getActionDim(); }
 
   void getState(Eigen::Ref<EigenVec> gc, Eigen::Ref<EigenVec> gv) {
     controller_.getState(gc, gv);
   }
 
+  [[nodiscard]] int getGcDim() const { return gcDim_; }
+  [[nodiscard]] int getGvDim() const { return gvDim_; }
+  static constexpr int getContactDim() { return 4; }
+
+  /// the generalized coordinate and velocity of the robot, in double precision
+  void getGeneralizedState(double* gc, double* gv) {
+    Eigen::Map<Eigen::VectorXd>(gc, gcDim_) = raibo_->getGeneralizedCoordinate().e();
+    Eigen::Map<Eigen::VectorXd>(gv, gvDim_) = raibo_->getGeneralizedVelocity().e();
+  }
+
+  /// moves the robot to the given state. The controller's histories are kept; only its state variables are updated
+  void setGeneralizedState(const double* gc, const double* gv) {
+    raibo_->setState(Eigen::Map<const Eigen::VectorXd>(gc, gcDim_), Eigen::Map<const Eigen::VectorXd>(gv, gvDim_));
+    controller_.updateStateVariables();
+  }
+
+  /// 1 for every foot (LF, RF, LH, RH) in contact with the ground at the last contact check
+  void getContacts(uint8_t* contacts) {
+    const auto& state = controller_.getFootContactState();
+    for (int i = 0; i < getContactDim(); i++) contacts[i] = state[i];
+  }
+
  protected:
+  void generateTerrain() {
+    terrainSeed_ = terrainGenerator_.getSeed();
+    heightMap_ = terrainGenerator_.generateTerrain(&world_, RandomHeightMapGenerator::GroundType(groundType_), curriculumFactor_);
+    if (recorder_.recording()) recordTerrain();
+  }
+
+  void recordTerrain() {
+    recorder_.terrain(int(heightMap_->getXSamples()), int(heightMap_->getYSamples()), heightMap_->getXSize(),
+                      heightMap_->getYSize(), heightMap_->getCenterX(), heightMap_->getCenterY(),
+                      heightMap_->getHeightVector());
+  }
+
+  void openResetBank(const std::string& fileName) {
+    resetBank_.open(fileName);
+    const auto& header = resetBank_.header();
+    RSFATAL_IF(int(header.gcDim) != gcDim_ || int(header.gvDim) != gvDim_ || header.commandDim != 3 ||
+               header.footCount != footFrameIndicies_.size(), fileName<<" was generated for a different robot")
+    RSFATAL_IF(resetBank_.sectionCount() == 0, fileName<<" has no states")
+    for (int s = 0; s < resetBank_.sectionCount(); s++)
+      RSFATAL_IF(resetBank_.count(s) == 0, "section "<<s<<" of "<<fileName<<" is empty")
+  }
+
+  /// copies a random state of the bank section of the current ground type into gc_init_, gv_init_ and state.command
+  void drawBankState(ResetState& state) {
+    const int section = groundType_ % resetBank_.sectionCount();
+    const size_t count = resetBank_.count(section);
+    const double* record = resetBank_.record(section, std::min(size_t(uniDist_(gen_) * double(count)), count - 1));
+    gc_init_ = Eigen::Map<const Eigen::VectorXd>(record, gcDim_);
+    gv_init_ = Eigen::Map<const Eigen::VectorXd>(record + gcDim_, gvDim_) * curriculumFactor_;
+    state.command = Eigen::Map<const Eigen::Vector3d>(record + gcDim_ + gvDim_);
+    bankFootOffsets_ = Eigen::Map<const Eigen::Matrix<double, 3, 4>>(record + gcDim_ + gvDim_ + 3);
+  }
+
+  /// precomputes resetCacheSize_ reset states. The robot state is restored afterwards
+  void fillResetCache() {
+    if (resetCacheSize_ == 0) return;
+    Eigen::VectorXd gc(gcDim_), gv(gvDim_);
+    raibo_->getState(gc, gv);
+    resetCache_.resize(resetCacheSize_);
+    for (auto& state: resetCache_)
+      sampleResetState(state);
+    raibo_->setState(gc, gv);
+  }
+
   static constexpr int nJoints_ = 12;
+  static constexpr uint32_t snapshotVersion_ = 4;
   raisim::World world_;
   double simulation_dt_;
   double control_dt_;
@@ -249,23 +552,35 @@ class ENVIRONMENT {
   raisim::HeightMap* heightMap_;
   Eigen::VectorXd gc_init_, gv_init_, nominalJointConfig_;
   Eigen::VectorXd gc_init_from_, gv_init_from_;
+  StartStateBuffer startStateBuffer_;
+  std::vector<const StartStateBuffer*> startStateSources_; /// buffers that resets sample from
+  int startStateRecordInterval_, controlStepsSinceRecord_ = 0;
+  int subStepsTaken_ = 0;
+  bool stepTerminal_ = false;
+  ResetState resetState_;
+  std::vector<ResetState> resetCache_;
+  int resetCacheSize_;
+  ResetStateBank resetBank_;
+  Eigen::Matrix<double, 3, 4> bankFootOffsets_;
   double curriculumFactor_, curriculumDecayFactor_;
-  Eigen::VectorXd obScaled_;
+  Eigen::VectorXd obScaled_, privilegedOb_;
   Eigen::Vector3d command_;
   bool visualizable_ = false;
-  int groundType_;
+  int groundType_, terrainSeed_;
   RandomHeightMapGenerator terrainGenerator_;
   RaiboController controller_;
+  std::shared_ptr<RaiboController::StateArena> controllerArena_;
+  TrajectoryRecorder recorder_;
+  uint64_t recordedSteps_ = 0;
+  RSG_PROFILE_ACCUMULATOR(stepTicks_)
 
   std::unique_ptr<raisim::RaisimServer> server_;
   raisim::Visuals *commandSphere_, *controllerSphere_;
 
-  thread_local static std::mt19937 gen_;
-  thread_local static std::normal_distribution<double> normDist_;
-  thread_local static std::uniform_real_distribution<double> uniDist_;
+  /// every environment owns its random number generators so that its random stream does not depend on the thread
+  /// stepping it and can be saved in a snapshot
+  std::mt19937 gen_;
+  std::normal_distribution<double> normDist_{0., 1.};
+  std::uniform_real_distribution<double> uniDist_{0., 1.};
 };
-
-thread_local std::mt19937 raisim::ENVIRONMENT::gen_;
-thread_local std::normal_distribution<double> raisim::ENVIRONMENT::normDist_(0., 1.);
-thread_local std::uniform_real_distribution<double> raisim::ENVIRONMENT::uniDist_(0., 1.);
 }
\ No newline at end of file
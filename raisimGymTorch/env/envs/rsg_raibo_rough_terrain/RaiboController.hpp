@@ -9,6 +9,96 @@ namespace raisim {
 
 class RaiboController {
  public:
+  enum RewardTerm : int {
+    COMMAND_TRACKING = 0,
+    CONTACT_SWITCH,
+    TORQUE,
+    SMOOTH,
+    ORIENTATION,
+    JOINT_VELOCITY,
+    SLIP,
+    AIRTIME,
+    REWARD_TERM_COUNT
+  };
+
+  /// The controller state that changes every step (histories, actions, foot positions and reward accumulators)
+  /// of many controllers in per-field matrices with one column per environment. Every controller owns an arena of
+  /// one environment; bindArena() moves its state into a shared arena so that the state of all environments is
+  /// contiguous and can be processed by batched kernels.
+  struct StateArena {
+    void resize(int envs) {
+      allocate(envs);
+      for (auto *field: {&jointPositionHistory, &jointVelocityHistory, &jointTarget, &previousAction, &prevprevAction,
+                         &footPosition, &rewards, &stepData})
+        field->setZero();
+    }
+
+    /// allocates the columns without writing them, so that every page lands on the NUMA node of the thread that
+    /// writes it first (bindArena())
+    void allocate(int envs) {
+      jointPositionHistory.resize(nJoints_ * historyLength_, envs);
+      jointVelocityHistory.resize(nJoints_ * historyLength_, envs);
+      jointTarget.resize(nJoints_, envs);
+      previousAction.resize(actionDim_, envs);
+      prevprevAction.resize(actionDim_, envs);
+      footPosition.resize(3 * 4, envs);
+      rewards.resize(REWARD_TERM_COUNT, envs);
+      stepData.resize(REWARD_TERM_COUNT, envs);
+    }
+
+    /// drops the oldest entry of the joint histories of all environments (the first step of updateHistory())
+    void shiftHistories() {
+      const int kept = nJoints_ * (historyLength_ - 1);
+      historyShiftBuffer = jointPositionHistory.bottomRows(kept);
+      jointPositionHistory.topRows(kept) = historyShiftBuffer;
+      historyShiftBuffer = jointVelocityHistory.bottomRows(kept);
+      jointVelocityHistory.topRows(kept) = historyShiftBuffer;
+    }
+
+    /// adds the reward sum of every environment to reward, then moves the accumulators to the step data
+    void collectRewards(Eigen::Ref<EigenVec> reward) {
+      reward += rewards.colwise().sum().transpose().cast<float>();
+      stepData = rewards;
+      rewards.setZero();
+    }
+
+    Eigen::MatrixXd jointPositionHistory, jointVelocityHistory;
+    Eigen::MatrixXd jointTarget, previousAction, prevprevAction;
+    Eigen::MatrixXd footPosition; /// 4 feet x (x, y, z)
+    Eigen::MatrixXd rewards, stepData; /// REWARD_TERM_COUNT rows
+    Eigen::MatrixXd historyShiftBuffer;
+  };
+
+  /// copies the current state into column id of the arena and makes the controller work on that column
+  void bindArena(StateArena &arena, int id) {
+    arena.jointPositionHistory.col(id) = jointPositionHistory_;
+    arena.jointVelocityHistory.col(id) = jointVelocityHistory_;
+    arena.jointTarget.col(id) = jointTarget_;
+    arena.previousAction.col(id) = previousAction_;
+    arena.prevprevAction.col(id) = prevprevAction_;
+    arena.footPosition.col(id) = Eigen::Map<Eigen::VectorXd>(footPos_.data(), 3 * 4);
+    arena.rewards.col(id) = rewards_;
+    arena.stepData.col(id) = stepData_;
+    rebindState(arena, id);
+  }
+
+  /// Eigen::Map views are rebound with placement new
+  void rebindState(StateArena &arena, int id) {
+    new (&jointPositionHistory_) Eigen::Map<Eigen::VectorXd>(arena.jointPositionHistory.col(id).data(), nJoints_ * historyLength_);
+    new (&jointVelocityHistory_) Eigen::Map<Eigen::VectorXd>(arena.jointVelocityHistory.col(id).data(), nJoints_ * historyLength_);
+    new (&jointTarget_) Eigen::Map<Eigen::VectorXd>(arena.jointTarget.col(id).data(), nJoints_);
+    new (&previousAction_) Eigen::Map<Eigen::VectorXd>(arena.previousAction.col(id).data(), actionDim_);
+    new (&prevprevAction_) Eigen::Map<Eigen::VectorXd>(arena.prevprevAction.col(id).data(), actionDim_);
+    new (&footPos_) Eigen::Map<Eigen::Matrix<double, 3, 4>>(arena.footPosition.col(id).data());
+    new (&rewards_) Eigen::Map<Eigen::VectorXd>(arena.rewards.col(id).data(), REWARD_TERM_COUNT);
+    new (&stepData_) Eigen::Map<Eigen::VectorXd>(arena.stepData.col(id).data(), REWARD_TERM_COUNT);
+  }
+
+  RaiboController() = default;
+  /// the views point into ownState_ or a shared arena
+  RaiboController(const RaiboController &) = delete;
+  RaiboController &operator=(const RaiboController &) = delete;
+
   inline bool create(raisim::World *world) {
     raibo_ = reinterpret_cast<raisim::ArticulatedSystem *>(world->getObject("robot"));
     gc_.resize(raibo_->getGeneralizedCoordinateDim());
@@ -21,21 +111,20 @@ class RaiboController {
     scanPoint_.resize(4, std::vector<raisim::Vec<2>>(scanConfig_.sum()));
     heightScan_.resize(4, raisim::VecDyn(scanConfig_.sum()));
 
+    /// the per-step state lives in an arena of this controller until bindArena() is called
+    ownState_.resize(1);
+    rebindState(ownState_, 0);
+
     /// Observation
-    jointPositionHistory_.setZero(nJoints_ * historyLength_);
-    jointVelocityHistory_.setZero(nJoints_ * historyLength_);
     historyTempMemory_.setZero(nJoints_ * historyLength_);
     nominalJointConfig_.setZero(nJoints_);
     nominalJointConfig_ << 0, 0.56, -1.12, 0, 0.56, -1.12, 0, 0.56, -1.12, 0, 0.56, -1.12;
-    jointTarget_.setZero(nJoints_);
     jointTargetDelta_.setZero(nJoints_);
 
     /// action
     actionMean_.setZero(actionDim_);
     actionStd_.setZero(actionDim_);
     actionScaled_.setZero(actionDim_);
-    previousAction_.setZero(actionDim_);
-    prevprevAction_.setZero(actionDim_);
 
     actionMean_ << nominalJointConfig_; /// joint target
     actionStd_ << Eigen::VectorXd::Constant(12, 0.1); /// joint target
@@ -81,6 +170,11 @@ class RaiboController {
     footIndices_.push_back(raibo_->getBodyIdx("RH_SHANK"));
     RSFATAL_IF(std::any_of(footIndices_.begin(), footIndices_.end(), [](int i){return i < 0;}), "footIndices_ not found")
 
+    /// body index -> foot index (-1 for the other bodies), so that the contact pass needs no search
+    bodyToFoot_.assign(*std::max_element(footIndices_.begin(), footIndices_.end()) + 1, -1);
+    for (size_t i = 0; i < footIndices_.size(); i++)
+      bodyToFoot_[footIndices_[i]] = int(i);
+
     /// indicies of the foot frame
     footFrameIndicies_.push_back(raibo_->getFrameIdxByName("LF_S2F"));
     footFrameIndicies_.push_back(raibo_->getFrameIdxByName("RF_S2F"));
@@ -97,7 +191,7 @@ class RaiboController {
                     "joint_vel_rew",
                     "slip_rew",
                     "airtime_rew"};
-    stepData_.resize(stepDataTag_.size());
+    RSFATAL_IF(stepDataTag_.size() != REWARD_TERM_COUNT, "a step data tag is needed for every reward term")
 
     /// heightmap
     scanCos_.resize(scanConfig_.size(), scanConfig_.maxCoeff());
@@ -114,17 +208,22 @@ class RaiboController {
     return true;
   };
 
-  void updateHistory() {
+  /// shifted: the oldest entries were already dropped by StateArena::shiftHistories()
+  void updateHistory(bool shifted = false) {
     /// joint angles
-    historyTempMemory_ = jointPositionHistory_;
-    jointPositionHistory_.head((historyLength_ - 1) * nJoints_) =
-        historyTempMemory_.tail((historyLength_ - 1) * nJoints_);
+    if (!shifted) {
+      historyTempMemory_ = jointPositionHistory_;
+      jointPositionHistory_.head((historyLength_ - 1) * nJoints_) =
+          historyTempMemory_.tail((historyLength_ - 1) * nJoints_);
+    }
     jointPositionHistory_.tail(nJoints_) = jointTarget_ - gc_.tail(nJoints_);
 
     /// joint velocities
-    historyTempMemory_ = jointVelocityHistory_;
-    jointVelocityHistory_.head((historyLength_ - 1) * nJoints_) =
-        historyTempMemory_.tail((historyLength_ - 1) * nJoints_);
+    if (!shifted) {
+      historyTempMemory_ = jointVelocityHistory_;
+      jointVelocityHistory_.head((historyLength_ - 1) * nJoints_) =
+          historyTempMemory_.tail((historyLength_ - 1) * nJoints_);
+    }
     jointVelocityHistory_.tail(nJoints_) = gv_.tail(nJoints_);
   }
 
@@ -142,8 +241,10 @@ class RaiboController {
     bodyAngVel_ = baseRot_.e().transpose() * gv_.segment(3, 3);
 
     /// foot info
+    raisim::Vec<3> footPosition;
     for (size_t i = 0; i < 4; i++) {
-      raibo_->getFramePosition(footFrameIndicies_[i], footPos_[i]);
+      raibo_->getFramePosition(footFrameIndicies_[i], footPosition);
+      footPos_.col(i) = footPosition.e();
       raibo_->getFrameVelocity(footFrameIndicies_[i], footVel_[i]);
     }
 
@@ -153,14 +254,16 @@ class RaiboController {
     controlFrameX_ /= controlFrameX_.norm();
     raisim::cross(zAxis_, controlFrameX_, controlFrameY_);
 
-    /// check if the feet are in contact with the ground
-
+    /// check if the feet are in contact with the ground. A contact of any other body or a self-collision terminates the episode
     for (auto &fs: footContactState_) fs = false;
+    terminal_ = false;
     for (auto &contact: raibo_->getContacts()) {
-      auto it = std::find(footIndices_.begin(), footIndices_.end(), contact.getlocalBodyIndex());
-      size_t index = it - footIndices_.begin();
-      if (index < 4 && !contact.isSelfCollision())
-        footContactState_[index] = true;
+      const size_t body = contact.getlocalBodyIndex();
+      const int foot = body < bodyToFoot_.size() ? bodyToFoot_[body] : -1;
+      if (foot < 0 || contact.isSelfCollision())
+        terminal_ = true;
+      else
+        footContactState_[foot] = true;
     }
   }
 
@@ -183,7 +286,7 @@ class RaiboController {
     pTarget_.tail(nJoints_) = jointTarget_;
     raibo_->setPdTarget(pTarget_, vTarget_);
 
-    smoothReward_ = curriculumFactor * smoothRewardCoeff_ * (prevprevAction_ + jointTarget_ - 2 * previousAction_).squaredNorm();
+    rewards_[SMOOTH] = curriculumFactor * smoothRewardCoeff_ * (prevprevAction_ + jointTarget_ - 2 * previousAction_).squaredNorm();
     return true;
   }
 
@@ -203,37 +306,15 @@ class RaiboController {
   }
 
   [[nodiscard]] float getRewardSum(bool visualize) {
-    stepData_[0] = commandTrackingReward_;
-    stepData_[1] = contactSwitchReward_;
-    stepData_[2] = torqueReward_;
-    stepData_[3] = smoothReward_;
-    stepData_[4] = orientationReward_;
-    stepData_[5] = jointVelocityReward_;
-    stepData_[6] = slipReward_;
-    stepData_[7] = airtimeReward_;
-
-    commandTrackingReward_ = 0.;
-    contactSwitchReward_ = 0.;
-    torqueReward_ = 0.;
-    smoothReward_ = 0.;
-    orientationReward_ = 0.;
-    jointVelocityReward_ = 0.;
-    slipReward_ = 0.;
-    airtimeReward_ = 0.;
-
+    stepData_ = rewards_;
+    rewards_.setZero();
     return float(stepData_.sum());
   }
 
-  [[nodiscard]] bool isTerminalState(float &terminalReward) {
-    terminalReward = float(terminalRewardCoeff_);
-
-    /// if the contact body is not feet
-    for (auto &contact: raibo_->getContacts())
-      if (std::find(footIndices_.begin(), footIndices_.end(), contact.getlocalBodyIndex()) == footIndices_.end() || contact.isSelfCollision())
-        return true;
-
-    terminalReward = 0.f;
-    return false;
+  /// computed by the contact pass of the last updateStateVariables() call
+  [[nodiscard]] bool isTerminalState(float &terminalReward) const {
+    terminalReward = terminal_ ? float(terminalRewardCoeff_) : 0.f;
+    return terminal_;
   }
 
   void updateObservation(bool nosify,
@@ -285,6 +366,17 @@ class RaiboController {
     obDouble_[34 + 2 * nJoints_ * 4 + 4 * scanConfig_.sum() + 2] = std::min(3., dist);
   }
 
+  /// the part of the critic observation the robot cannot sense: foot contact states, foot heights above the terrain
+  /// and horizontal foot velocities (world frame), computed from the state of the last updateStateVariables() call
+  void getPrivilegedObservation(Eigen::Ref<Eigen::VectorXd> privileged, const raisim::HeightMap *map) const {
+    for (int i = 0; i < 4; i++) {
+      privileged[i] = footContactState_[i] ? 1. : 0.;
+      privileged[4 + i] = footPos_(2, i) - map->getHeight(footPos_(0, i), footPos_(1, i));
+      privileged[8 + 2 * i] = footVel_[i][0];
+      privileged[9 + 2 * i] = footVel_[i][1];
+    }
+  }
+
   inline void setRewardConfig(const Yaml::Node &cfg) {
     READ_YAML(double, commandTrackingRewardCoeff, cfg["reward"]["command_tracking_reward_coeff"])
     READ_YAML(double, torqueRewardCoeff_, cfg["reward"]["torque_reward_coeff"])
@@ -297,7 +389,7 @@ class RaiboController {
   }
 
   inline void accumulateRewards(double cf, const Eigen::Vector3d &cm) {
-    torqueReward_ += cf * torqueRewardCoeff_ * (raibo_->getGeneralizedForce().e().tail(12).squaredNorm()) * simDt_;
+    rewards_[TORQUE] += cf * torqueRewardCoeff_ * (raibo_->getGeneralizedForce().e().tail(12).squaredNorm()) * simDt_;
 //    commandTrackingReward_ += cm[0] > 0 ? std::min(bodyLinVel_[0], cm[0]) : -std::max(bodyLinVel_[0], cm[0]);
 //    commandTrackingReward_ += cm[1] > 0 ? std::min(bodyLinVel_[1], cm[1]) : -std::max(bodyLinVel_[1], cm[1]);
 //    commandTrackingReward_ -= 2.0 * fabs(bodyLinVel_[2]);
@@ -306,14 +398,14 @@ class RaiboController {
     Eigen::Vector2d posXy; posXy << gc_[0], gc_[1];
     Eigen::Vector2d targetRel; targetRel = cm.head(2) - posXy;
     Eigen::Vector2d heading; heading << baseRot_[0], baseRot_[1];
-    commandTrackingReward_ += 6. - targetRel.norm();
-    commandTrackingReward_ += 0.3 * heading.dot(targetRel) / (targetRel.norm() * heading.norm());
-    commandTrackingReward_ *= commandTrackingRewardCoeff * simDt_;
+    rewards_[COMMAND_TRACKING] += 6. - targetRel.norm();
+    rewards_[COMMAND_TRACKING] += 0.3 * heading.dot(targetRel) / (targetRel.norm() * heading.norm());
+    rewards_[COMMAND_TRACKING] *= commandTrackingRewardCoeff * simDt_;
 
 //    orientationReward_ += cf * orientationRewardCoeff_ * simDt_ * std::asin(baseRot_[7]) * std::asin(baseRot_[7]);
-    orientationReward_ += cf * orientationRewardCoeff_ * simDt_ * (gc_[7]*gc_[7] + gc_[10]*gc_[10] + gc_[13]*gc_[13] + gc_[16]*gc_[16]);
+    rewards_[ORIENTATION] += cf * orientationRewardCoeff_ * simDt_ * (gc_[7]*gc_[7] + gc_[10]*gc_[10] + gc_[13]*gc_[13] + gc_[16]*gc_[16]);
 
-    jointVelocityReward_ += cf * jointVelocityRewardCoeff_ * simDt_ * jointVelocity_.squaredNorm();
+    rewards_[JOINT_VELOCITY] += cf * jointVelocityRewardCoeff_ * simDt_ * jointVelocity_.squaredNorm();
 //    for(int i=0; i<12; i++)
 //      jointVelocityReward_ += cf * jointVelocityRewardCoeff_ * simDt_ * std::abs(jointVelocity_[i]*jointVelocity_[i]*jointVelocity_[i]);
 
@@ -321,7 +413,7 @@ class RaiboController {
     for (int i=0; i< raibo_->getContacts().size(); i++) {
       if (raibo_->getContacts()[i].isSelfCollision() ) continue;
       raibo_->getContactPointVel(i, conVel);
-      slipReward_ += cf * slipRewardCoeff_ * conVel.e().head(2).squaredNorm();
+      rewards_[SLIP] += cf * slipRewardCoeff_ * conVel.e().head(2).squaredNorm();
     }
 //    for (size_t i = 0; i < 4; i++)
 //      if (footContactState_[i])
@@ -331,7 +423,7 @@ class RaiboController {
         !footContactState_[1] &&
         !footContactState_[2] &&
         !footContactState_[3])
-      contactSwitchReward_ += contactSwitchRewardCoeff_ * simDt_;
+      rewards_[CONTACT_SWITCH] += contactSwitchRewardCoeff_ * simDt_;
   }
 
   void updateHeightScan(const raisim::HeightMap *map,
@@ -343,12 +435,12 @@ class RaiboController {
         const double distance = 0.07 * (k + 1);
         for (int i = 0; i < 4; i++) {
           scanPoint_[i][scanConfig_.head(k).sum() + j][0] =
-              footPos_[i][0] + controlFrameX_[0] * distance * scanCos_(k,j) + controlFrameY_[0] * distance * scanSin_(k,j);
+              footPos_(0, i) + controlFrameX_[0] * distance * scanCos_(k,j) + controlFrameY_[0] * distance * scanSin_(k,j);
           scanPoint_[i][scanConfig_.head(k).sum() + j][1] =
-              footPos_[i][1] + controlFrameX_[1] * distance * scanCos_(k,j) + controlFrameY_[1] * distance * scanSin_(k,j);
+              footPos_(1, i) + controlFrameX_[1] * distance * scanCos_(k,j) + controlFrameY_[1] * distance * scanSin_(k,j);
           heightScan_[i][scanConfig_.head(k).sum() + j] =
               map->getHeight(scanPoint_[i][scanConfig_.head(k).sum() + j][0],
-                             scanPoint_[i][scanConfig_.head(k).sum() + j][1]) - footPos_[i][2] + normDist_(gen_) * 0.025;
+                             scanPoint_[i][scanConfig_.head(k).sum() + j][1]) - footPos_(2, i) + normDist_(gen_) * 0.025;
         }
       }
     }
@@ -356,10 +448,40 @@ class RaiboController {
 
   inline void setStandingMode(bool mode) { standingMode_ = mode; }
 
-  [[nodiscard]] const Eigen::VectorXd &getJointPositionHistory() const { return jointPositionHistory_; }
-  [[nodiscard]] const Eigen::VectorXd &getJointVelocityHistory() const { return jointVelocityHistory_; }
+  /// the controller state that is not recomputed by updateStateVariables(). The robot state is saved by the environment
+  void writeSnapshot(SnapshotWriter &writer) const {
+    writer.writeVector(jointPositionHistory_);
+    writer.writeVector(jointVelocityHistory_);
+    writer.writeVector(jointTarget_);
+    writer.writeVector(previousAction_);
+    writer.writeVector(prevprevAction_);
+    writer.writeVector(stepData_);
+    writer.write(standingMode_);
+    for (int i = 0; i < REWARD_TERM_COUNT; i++)
+      writer.write(rewards_[i]);
+  }
+
+  void readSnapshot(SnapshotReader &reader) {
+    reader.readVector(jointPositionHistory_);
+    reader.readVector(jointVelocityHistory_);
+    reader.readVector(jointTarget_);
+    reader.readVector(previousAction_);
+    reader.readVector(prevprevAction_);
+    reader.readVector(stepData_);
+    standingMode_ = reader.read<bool>();
+    for (int i = 0; i < REWARD_TERM_COUNT; i++)
+      rewards_[i] = reader.read<double>();
+
+    pTarget_.tail(nJoints_) = jointTarget_;
+    raibo_->setPdTarget(pTarget_, vTarget_);
+    updateStateVariables();
+  }
+
+  [[nodiscard]] const Eigen::Map<Eigen::VectorXd> &getJointPositionHistory() const { return jointPositionHistory_; }
+  [[nodiscard]] const Eigen::Map<Eigen::VectorXd> &getJointVelocityHistory() const { return jointVelocityHistory_; }
 
   [[nodiscard]] static constexpr int getObDim() { return obDim_; }
+  [[nodiscard]] static constexpr int getPrivilegedObDim() { return privilegedObDim_; }
   [[nodiscard]] static constexpr int getActionDim() { return actionDim_; }
   [[nodiscard]] static constexpr double getSimDt() { return simDt_; }
   [[nodiscard]] static constexpr double getConDt() { return conDt_; }
@@ -369,7 +491,8 @@ class RaiboController {
   static void setConDt(double dt) { RSFATAL_IF(fabs(dt - conDt_) > 1e-12, "con dt is fixed to " << conDt_)};
 
   [[nodiscard]] inline const std::vector<std::string> &getStepDataTag() const { return stepDataTag_; }
-  [[nodiscard]] inline const Eigen::VectorXd &getStepData() const { return stepData_; }
+  [[nodiscard]] inline const Eigen::Map<Eigen::VectorXd> &getStepData() const { return stepData_; }
+  [[nodiscard]] inline const std::array<bool, 4> &getFootContactState() const { return footContactState_; }
 
   // robot configuration variables
   raisim::ArticulatedSystem *raibo_;
@@ -379,6 +502,7 @@ class RaiboController {
   static constexpr int actionDim_ = 12;
   static constexpr size_t historyLength_ = 14;
   static constexpr size_t obDim_ = 333;
+  static constexpr int privilegedObDim_ = 16;
   static constexpr double simDt_ = .001;
   static constexpr int gcDim_ = 19;
   static constexpr int gvDim_ = 18;
@@ -387,12 +511,15 @@ class RaiboController {
   Eigen::VectorXd gc_, gv_;
   Eigen::Vector3d bodyLinVel_, bodyAngVel_; /// body velocities are expressed in the body frame
   Eigen::VectorXd jointVelocity_;
-  std::array<raisim::Vec<3>, 4> footPos_, footVel_;
+  Eigen::Map<Eigen::Matrix<double, 3, 4>> footPos_{nullptr}; /// one column per foot
+  std::array<raisim::Vec<3>, 4> footVel_;
   raisim::Vec<3> zAxis_ = {0., 0., 1.}, controlFrameX_, controlFrameY_;
-  Eigen::VectorXd jointPositionHistory_;
-  Eigen::VectorXd jointVelocityHistory_;
+  Eigen::Map<Eigen::VectorXd> jointPositionHistory_{nullptr, 0};
+  Eigen::Map<Eigen::VectorXd> jointVelocityHistory_{nullptr, 0};
   Eigen::VectorXd historyTempMemory_;
   std::array<bool, 4> footContactState_;
+  std::vector<int> bodyToFoot_;
+  bool terminal_ = false;
   raisim::Mat<3, 3> baseRot_;
 
   // robot observation variables
@@ -406,25 +533,30 @@ class RaiboController {
   // control variables
   static constexpr double conDt_ = 0.005;
   bool standingMode_ = false;
-  Eigen::VectorXd actionMean_, actionStd_, actionScaled_, previousAction_, prevprevAction_;
+  Eigen::VectorXd actionMean_, actionStd_, actionScaled_;
+  Eigen::Map<Eigen::VectorXd> previousAction_{nullptr, 0}, prevprevAction_{nullptr, 0};
   Eigen::VectorXd pTarget_, vTarget_; // full robot gc dim
-  Eigen::VectorXd jointTarget_, jointTargetDelta_;
+  Eigen::Map<Eigen::VectorXd> jointTarget_{nullptr, 0};
+  Eigen::VectorXd jointTargetDelta_;
   Eigen::VectorXd jointPgain_, jointDgain_;
 
   // reward variables
-  double commandTrackingRewardCoeff = 0., commandTrackingReward_ = 0.;
-  double contactSwitchRewardCoeff_ = 0., contactSwitchReward_ = 0.;
-  double torqueRewardCoeff_ = 0., torqueReward_ = 0.;
-  double smoothRewardCoeff_ = 0., smoothReward_ = 0.;
-  double orientationRewardCoeff_ = 0., orientationReward_ = 0.;
-  double jointVelocityRewardCoeff_ = 0., jointVelocityReward_ = 0.;
-  double slipRewardCoeff_ = 0., slipReward_ = 0.;
-  double airtimeRewardCoeff_ = 0., airtimeReward_ = 0.;
+  double commandTrackingRewardCoeff = 0.;
+  double contactSwitchRewardCoeff_ = 0.;
+  double torqueRewardCoeff_ = 0.;
+  double smoothRewardCoeff_ = 0.;
+  double orientationRewardCoeff_ = 0.;
+  double jointVelocityRewardCoeff_ = 0.;
+  double slipRewardCoeff_ = 0.;
+  double airtimeRewardCoeff_ = 0.;
   double terminalRewardCoeff_ = 0.0;
+  Eigen::Map<Eigen::VectorXd> rewards_{nullptr, 0}; /// accumulators of the current control step, indexed by RewardTerm
 
   // exported data
-  Eigen::VectorXd stepData_;
+  Eigen::Map<Eigen::VectorXd> stepData_{nullptr, 0}; /// rewards of the last control step
   std::vector<std::string> stepDataTag_;
+
+  StateArena ownState_;
 };
 
 }
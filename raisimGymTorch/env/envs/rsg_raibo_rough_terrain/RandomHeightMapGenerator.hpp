@@ -25,11 +25,12 @@ class RandomHeightMapGenerator {
     terrain_seed_ = seed;
   }
 
+  /// seed of the next terrain. A terrain is fully determined by its ground type, curriculum factor and seed
+  [[nodiscard]] int getSeed() const { return terrain_seed_; }
+
   raisim::HeightMap* generateTerrain(raisim::World* world,
       GroundType groundType,
-      double curriculumFactor,
-      std::mt19937& gen,
-      std::uniform_real_distribution<double>& uniDist) {
+      double curriculumFactor) {
     std::vector<double> heightVec;
     heightVec.resize(heightMapSampleSize_*heightMapSampleSize_);
     std::unique_ptr<raisim::TerrainGenerator> genPtr;
@@ -70,8 +71,9 @@ class RandomHeightMapGenerator {
 
         return world->addHeightMap(80, 80, 12.0, 12.0, 0., 0., heightVec);
 
-      case GroundType::STEPS:
-
+      case GroundType::STEPS: {
+        std::mt19937 gen(terrain_seed_++);
+        std::uniform_real_distribution<double> uniDist(0., 1.);
         heightVec.resize(120*120);
         for(int xBlock = 0; xBlock < 15; xBlock++) {
           for(int yBlock = 0; yBlock < 15; yBlock++) {
@@ -85,6 +87,7 @@ class RandomHeightMapGenerator {
         }
 
         return world->addHeightMap(120, 120, 12.0, 12.0, 0., 0., heightVec);
+      }
 
       case GroundType::STAIRS:
         heightVec.resize(200*200);
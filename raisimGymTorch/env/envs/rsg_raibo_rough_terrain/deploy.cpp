@@ -0,0 +1,181 @@
+//----------------------------//
+// This file is part of RaiSim//
+// Copyright 2020, RaiSim Tech//
+//----------------------------//
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include "Environment.hpp"
+#include "../../AppHelper.hpp"
+#include "../../MicroBenchmark.hpp"
+#include "../../PolicyRuntime.hpp"
+
+#if defined(__GLIBC__)
+/// Count every heap allocation. operator new (including the over-aligned one, which uses aligned_alloc) and Eigen
+/// all end up in one of these functions
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t num, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void *__libc_memalign(size_t alignment, size_t size);
+extern "C" void *__libc_valloc(size_t size);
+extern "C" void *__libc_pvalloc(size_t size);
+
+extern "C" void *malloc(size_t size) {
+  raisim::microbench::allocationCount().fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t num, size_t size) {
+  raisim::microbench::allocationCount().fetch_add(1, std::memory_order_relaxed);
+  return __libc_calloc(num, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) {
+  raisim::microbench::allocationCount().fetch_add(1, std::memory_order_relaxed);
+  return __libc_realloc(ptr, size);
+}
+
+extern "C" void *memalign(size_t alignment, size_t size) {
+  raisim::microbench::allocationCount().fetch_add(1, std::memory_order_relaxed);
+  return __libc_memalign(alignment, size);
+}
+
+extern "C" void *aligned_alloc(size_t alignment, size_t size) {
+  raisim::microbench::allocationCount().fetch_add(1, std::memory_order_relaxed);
+  return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void **ptr, size_t alignment, size_t size) {
+  if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) return EINVAL;
+  raisim::microbench::allocationCount().fetch_add(1, std::memory_order_relaxed);
+  void *memory = __libc_memalign(alignment, size);
+  if (!memory && size > 0) return ENOMEM;
+  *ptr = memory;
+  return 0;
+}
+
+extern "C" void *valloc(size_t size) {
+  raisim::microbench::allocationCount().fetch_add(1, std::memory_order_relaxed);
+  return __libc_valloc(size);
+}
+
+extern "C" void *pvalloc(size_t size) {
+  raisim::microbench::allocationCount().fetch_add(1, std::memory_order_relaxed);
+  return __libc_pvalloc(size);
+}
+#endif
+
+using namespace raisim;
+
+/// the robot of a single environment as the plant, observed the way the policy was trained but without the
+/// observation noise
+class DeployEnvironment : public ENVIRONMENT {
+ public:
+  DeployEnvironment(const std::string &resourceDir, const Yaml::Node &cfg, bool visualize) :
+      ENVIRONMENT(resourceDir, cfg, visualize, 0) {
+    reset();
+  }
+
+  void observeForDeployment(Eigen::Ref<EigenVec> ob) {
+    controller_.updateObservation(false, command_, heightMap_, gen_, normDist_);
+    controller_.getObservation(obScaled_);
+    ob = obScaled_.cast<float>();
+  }
+};
+
+int main(int argc, char *argv[]) {
+  RSFATAL_IF(argc < 4, "got "<<argc<<" arguments. "<<"This executable takes at least three arguments: 1. resource directory, 2. policy directory, 3. iteration\n"
+      <<"options: --weights <file> --cfg <file> --seconds <s> --realtime <0|1> --budget-us <us> --visualize <0|1> --bench <0|1>")
+
+  std::string resourceDir(argv[1]), policyDir(argv[2]), iteration(argv[3]);
+  std::string weightFile = policyDir + "/actor_" + iteration + ".bin", cfgFile = policyDir + "/cfg.yaml";
+  double seconds = 10., budgetUs = RaiboController::getConDt() * 1e6;
+  bool realtime = true, visualize = false, bench = false;
+
+  for (int i = 4; i < argc; i++) {
+    std::string arg(argv[i]);
+    RSFATAL_IF(i + 1 >= argc, "missing value for "<<arg)
+    std::string value(argv[++i]);
+    if (arg == "--weights") weightFile = value;
+    else if (arg == "--cfg") cfgFile = value;
+    else if (arg == "--seconds") seconds = std::stod(value);
+    else if (arg == "--realtime") realtime = std::stoi(value) != 0;
+    else if (arg == "--budget-us") budgetUs = std::stod(value);
+    else if (arg == "--visualize") visualize = std::stoi(value) != 0;
+    else if (arg == "--bench") bench = std::stoi(value) != 0;
+    else RSFATAL("unknown option "<<arg)
+  }
+
+  Yaml::Node config;
+  Yaml::Parse(config, readEnvironmentConfig(cfgFile));
+  DeployEnvironment env(resourceDir, config, visualize);
+
+  PolicyRuntime runtime;
+  const std::string scalingFile = policyDir + "/scaling" + iteration + ".bin";
+  if (std::ifstream(scalingFile).good())
+    runtime.load(weightFile, scalingFile);
+  else
+    runtime.load(weightFile, policyDir + "/mean" + iteration + ".csv", policyDir + "/var" + iteration + ".csv");
+  RSFATAL_IF(runtime.obDim() != env.getObDim() || runtime.actionDim() != env.getActionDim(),
+             "the policy maps "<<runtime.obDim()<<" observations to "<<runtime.actionDim()<<" actions, the environment has "
+             <<env.getObDim()<<" and "<<env.getActionDim())
+
+  EigenVec ob(env.getObDim()), action(env.getActionDim());
+
+  if (bench) {
+    microbench::Runner runner;
+    runner.printHeader();
+    runner.run("deploy/observe", [&]() { env.observeForDeployment(ob); });
+    EigenVec raw = ob;
+    runner.run("deploy/normalize+policy", [&]() { ob = raw; action = runtime.act(ob); });
+    runner.run("deploy/control step", [&]() { env.observeForDeployment(ob); action = runtime.act(ob); });
+    return 0;
+  }
+
+  /// the control loop: observe, normalize and infer within the budget, then advance the plant by one control step
+  const double controlDt = RaiboController::getConDt();
+  const int steps = int(seconds / controlDt);
+  RSFATAL_IF(steps <= 0, "--seconds must cover at least one control step")
+  std::vector<double> latencies(steps);
+  size_t allocations = 0;
+  int overruns = 0, episodes = 1;
+  float terminalReward;
+  /// the first call fills the lazily allocated buffers of the controller
+  env.observeForDeployment(ob);
+  action = runtime.act(ob);
+  auto nextTick = std::chrono::steady_clock::now();
+
+  for (int k = 0; k < steps; k++) {
+    const size_t allocationsBefore = microbench::allocationCount().load(std::memory_order_relaxed);
+    const auto start = std::chrono::steady_clock::now();
+    env.observeForDeployment(ob);
+    action = runtime.act(ob);
+    const auto end = std::chrono::steady_clock::now();
+    allocations += microbench::allocationCount().load(std::memory_order_relaxed) - allocationsBefore;
+    latencies[k] = std::chrono::duration<double, std::micro>(end - start).count();
+    overruns += latencies[k] > budgetUs;
+
+    env.step(action, visualize);
+    if (env.isTerminalState(terminalReward)) {
+      env.reset();
+      episodes++;
+    }
+
+    if (realtime) {
+      nextTick += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(controlDt));
+      std::this_thread::sleep_until(nextTick);
+    }
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&](double p) { return latencies[std::min(size_t(p * double(steps)), latencies.size() - 1)]; };
+  std::cout << "[RAISIM_GYM] " << steps << " control steps at " << 1. / controlDt << " Hz, " << episodes << " episodes\n"
+            << "observe + policy latency (us): p50 " << percentile(0.5) << " p99 " << percentile(0.99)
+            << " max " << latencies.back() << "\n"
+            << "over the " << budgetUs << " us budget: " << overruns << " steps, heap allocations: " << allocations
+            << std::endl;
+  return overruns > 0;
+}
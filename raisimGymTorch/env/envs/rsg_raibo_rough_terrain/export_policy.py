@@ -0,0 +1,31 @@
+import os
+import argparse
+import torch
+from ruamel.yaml import YAML
+import raisimGymTorch.algo.ppo.module as ppo_module
+
+
+# writes actor_<iteration>.bin next to a full_<iteration>.pt checkpoint, for rsg_raibo_rough_terrain_deploy
+parser = argparse.ArgumentParser()
+parser.add_argument('-w', '--weight', help='trained weight path (full_<iteration>.pt)', type=str, required=True)
+args = parser.parse_args()
+
+weight_path = args.weight
+weight_dir, weight_name = os.path.split(weight_path)
+iteration_number = weight_name.split('_', 1)[1].rsplit('.', 1)[0]
+
+# the configuration saved with the weights
+cfg_path = os.path.join(weight_dir, "cfg.yaml")
+if not os.path.exists(cfg_path):
+    cfg_path = os.path.dirname(os.path.realpath(__file__)) + "/cfg.yaml"
+cfg = YAML().load(open(cfg_path, 'r'))
+
+state_dict = torch.load(weight_path, map_location='cpu')['actor_architecture_state_dict']
+weights = [value for key, value in state_dict.items() if key.endswith('weight')]
+ob_dim, act_dim = weights[0].shape[1], weights[-1].shape[0]
+
+actor = ppo_module.MLP(cfg['architecture']['policy_net'], torch.nn.LeakyReLU, ob_dim, act_dim)
+actor.load_state_dict(state_dict)
+output_path = os.path.join(weight_dir, "actor_" + iteration_number + ".bin")
+actor.export_weights(output_path)
+print("exported the actor to", output_path)
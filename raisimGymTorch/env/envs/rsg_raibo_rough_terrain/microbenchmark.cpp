@@ -0,0 +1,133 @@
+//----------------------------//
+// This file is part of RaiSim//
+// Copyright 2020, RaiSim Tech//
+//----------------------------//
+
+#include <cerrno>
+#include "Environment.hpp"
+#include "../../AppHelper.hpp"
+#include "../../MicroBenchmark.hpp"
+
+#if defined(__GLIBC__)
+/// Count every heap allocation. operator new (including the over-aligned one, which uses aligned_alloc) and Eigen
+/// all end up in one of these functions
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t num, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void *__libc_memalign(size_t alignment, size_t size);
+extern "C" void *__libc_valloc(size_t size);
+extern "C" void *__libc_pvalloc(size_t size);
+
+extern "C" void *malloc(size_t size) {
+  raisim::microbench::allocationCount().fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t num, size_t size) {
+  raisim::microbench::allocationCount().fetch_add(1, std::memory_order_relaxed);
+  return __libc_calloc(num, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) {
+  raisim::microbench::allocationCount().fetch_add(1, std::memory_order_relaxed);
+  return __libc_realloc(ptr, size);
+}
+
+extern "C" void *memalign(size_t alignment, size_t size) {
+  raisim::microbench::allocationCount().fetch_add(1, std::memory_order_relaxed);
+  return __libc_memalign(alignment, size);
+}
+
+extern "C" void *aligned_alloc(size_t alignment, size_t size) {
+  raisim::microbench::allocationCount().fetch_add(1, std::memory_order_relaxed);
+  return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void **ptr, size_t alignment, size_t size) {
+  if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) return EINVAL;
+  raisim::microbench::allocationCount().fetch_add(1, std::memory_order_relaxed);
+  void *memory = __libc_memalign(alignment, size);
+  if (!memory && size > 0) return ENOMEM;
+  *ptr = memory;
+  return 0;
+}
+
+extern "C" void *valloc(size_t size) {
+  raisim::microbench::allocationCount().fetch_add(1, std::memory_order_relaxed);
+  return __libc_valloc(size);
+}
+
+extern "C" void *pvalloc(size_t size) {
+  raisim::microbench::allocationCount().fetch_add(1, std::memory_order_relaxed);
+  return __libc_pvalloc(size);
+}
+#endif
+
+using namespace raisim;
+
+/// exposes the controller of a single environment so that its functions can be timed in isolation
+class BenchEnvironment : public ENVIRONMENT {
+ public:
+  BenchEnvironment(const std::string &resourceDir, const Yaml::Node &cfg, RandomHeightMapGenerator::GroundType groundType) :
+      ENVIRONMENT(resourceDir, cfg, false, (int(groundType) + 1) % 4) {
+    RSFATAL_IF(groundType_ != int(groundType), "unexpected ground type")
+    reset();
+
+    /// settle into a representative state (feet in contact, non-zero history)
+    EigenVec action = EigenVec::Zero(getActionDim());
+    for (int i = 0; i < 100; i++)
+      step(action, false);
+  }
+
+  void registerBenchmarks(microbench::Runner &runner, const std::string &prefix) {
+    float terminalReward;
+    bool terminal = false;
+    runner.run(prefix + "/updateHistory", [&]() { controller_.updateHistory(); });
+    runner.run(prefix + "/updateStateVariables", [&]() { controller_.updateStateVariables(); });
+    runner.run(prefix + "/updateHeightScan", [&]() { controller_.updateHeightScan(heightMap_, gen_, normDist_); });
+    runner.run(prefix + "/updateObservation", [&]() { controller_.updateObservation(true, command_, heightMap_, gen_, normDist_); });
+    runner.run(prefix + "/accumulateRewards", [&]() { controller_.accumulateRewards(curriculumFactor_, command_); });
+    runner.run(prefix + "/isTerminalState", [&]() { terminal ^= controller_.isTerminalState(terminalReward); });
+    benchmarkSink_ = terminal;
+  }
+
+  bool benchmarkSink_ = false;
+};
+
+int main(int argc, char *argv[]) {
+  RSFATAL_IF(argc < 3, "got "<<argc<<" arguments. "<<"This executable takes at least two arguments: 1. resource directory, 2. configuration file\n"
+      <<"options: --filter <substring> --min-time <seconds> --repetitions <n>")
+
+  std::string resourceDir(argv[1]), cfgFile(argv[2]);
+  std::string filter;
+  double minTime = 0.1;
+  int repetitions = 5;
+
+  for (int i = 3; i < argc; i++) {
+    std::string arg(argv[i]);
+    RSFATAL_IF(i + 1 >= argc, "missing value for "<<arg)
+    std::string value(argv[++i]);
+    if (arg == "--filter") filter = value;
+    else if (arg == "--min-time") minTime = std::stod(value);
+    else if (arg == "--repetitions") repetitions = std::stoi(value);
+    else RSFATAL("unknown option "<<arg)
+  }
+
+  Yaml::Node config;
+  Yaml::Parse(config, readEnvironmentConfig(cfgFile));
+
+  const std::vector<std::pair<RandomHeightMapGenerator::GroundType, std::string>> groundTypes = {
+      {RandomHeightMapGenerator::GroundType::HEIGHT_MAP, "HEIGHT_MAP"},
+      {RandomHeightMapGenerator::GroundType::HEIGHT_MAP_DISCRETE, "HEIGHT_MAP_DISCRETE"},
+      {RandomHeightMapGenerator::GroundType::STEPS, "STEPS"},
+      {RandomHeightMapGenerator::GroundType::STAIRS, "STAIRS"}};
+
+  microbench::Runner runner(minTime, repetitions, filter);
+  runner.printHeader();
+
+  for (auto &groundType: groundTypes) {
+    BenchEnvironment env(resourceDir, config, groundType.first);
+    env.registerBenchmarks(runner, groundType.second);
+  }
+  return 0;
+}
@@ -0,0 +1,78 @@
+//----------------------------//
+// This file is part of RaiSim//
+// Copyright 2020, RaiSim Tech//
+//----------------------------//
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include "raisim/World.hpp"
+#include "raisim/RaisimServer.hpp"
+#include "../../TrajectoryRecorder.hpp"
+
+using namespace raisim;
+
+/// plays a trajectory recorded by startRecordingTrajectory() back through a RaisimServer, so that it can be watched
+/// or rendered to a video after training. Only the kinematics are replayed; the world is never integrated
+int main(int argc, char *argv[]) {
+  RSFATAL_IF(argc < 3, "got "<<argc<<" arguments. "<<"This executable takes at least two arguments: 1. resource directory, 2. trajectory file\n"
+      <<"options: --speed <real time factor> --video <video file> --port <n>")
+
+  std::string resourceDir(argv[1]), trajectoryFile(argv[2]), videoFile;
+  double speed = 1.;
+  int port = 8080;
+
+  for (int i = 3; i < argc; i++) {
+    std::string arg(argv[i]);
+    RSFATAL_IF(i + 1 >= argc, "missing value for "<<arg)
+    std::string value(argv[++i]);
+    if (arg == "--speed") speed = std::stod(value);
+    else if (arg == "--video") videoFile = value;
+    else if (arg == "--port") port = std::stoi(value);
+    else RSFATAL("unknown option "<<arg)
+  }
+  RSFATAL_IF(speed <= 0., "--speed must be positive")
+
+  TrajectoryReader reader(trajectoryFile);
+  raisim::World world;
+  auto *raibo = world.addArticulatedSystem(resourceDir + "/raibot/urdf/raibot_simplified.urdf");
+  RSFATAL_IF(int(raibo->getGeneralizedCoordinateDim()) != int(reader.header().gcDim),
+             trajectoryFile<<" was recorded for a different robot")
+  raisim::HeightMap *heightMap = nullptr;
+
+  raisim::RaisimServer server(&world);
+  server.launchServer(port);
+  if (!videoFile.empty()) server.startRecordingVideo(videoFile);
+
+  const auto frameTime = std::chrono::duration<double>(reader.header().controlDt / speed);
+  auto nextFrame = std::chrono::steady_clock::now();
+  TrajectoryReader::RecordType type;
+  TrajectoryReader::Terrain terrain;
+  Eigen::VectorXd gc;
+  uint64_t step = 0, frames = 0, episodes = 0;
+
+  while (reader.next(type, step, terrain, gc)) {
+    server.lockVisualizationServerMutex();
+    if (type == TrajectoryRecorder::TERRAIN) {
+      if (heightMap) world.removeObject(heightMap);
+      heightMap = world.addHeightMap(terrain.xSamples, terrain.ySamples, terrain.xSize, terrain.ySize,
+                                     terrain.centerX, terrain.centerY, terrain.heights);
+    } else if (type == TrajectoryRecorder::FRAME) {
+      raibo->setGeneralizedCoordinate(gc);
+      frames++;
+    } else if (type == TrajectoryRecorder::EPISODE) {
+      episodes++;
+    }
+    server.unlockVisualizationServerMutex();
+
+    if (type == TrajectoryRecorder::FRAME) {
+      nextFrame += std::chrono::duration_cast<std::chrono::steady_clock::duration>(frameTime);
+      std::this_thread::sleep_until(nextFrame);
+    }
+  }
+
+  if (!videoFile.empty()) server.stopRecordingVideo();
+  server.killServer();
+  std::cout << "[RAISIM_GYM] replayed " << frames << " frames of " << episodes << " episodes" << std::endl;
+  return 0;
+}
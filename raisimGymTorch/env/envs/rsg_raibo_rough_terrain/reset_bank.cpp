@@ -0,0 +1,87 @@
+//----------------------------//
+// This file is part of RaiSim//
+// Copyright 2020, RaiSim Tech//
+//----------------------------//
+
+#include "Environment.hpp"
+#include "../../AppHelper.hpp"
+
+using namespace raisim;
+
+/// samples the terrain-independent part of the initial states of one ground type
+class BankGenerator : public ENVIRONMENT {
+ public:
+  BankGenerator(const std::string &resourceDir, const Yaml::Node &cfg, RandomHeightMapGenerator::GroundType groundType, int seed) :
+      ENVIRONMENT(resourceDir, cfg, false, (int(groundType) + 1) % 4) {
+    RSFATAL_IF(groundType_ != int(groundType), "unexpected ground type")
+    setSeed(seed);
+  }
+
+  static ResetStateBank::Header layout(int gcDim, int gvDim) {
+    ResetStateBank::Header header{};
+    header.gcDim = uint32_t(gcDim);
+    header.gvDim = uint32_t(gvDim);
+    header.commandDim = 3;
+    header.footCount = 4;
+    return header;
+  }
+
+  /// one column per state: gc | gv at curriculum factor 1 | command | foot positions relative to the base
+  Eigen::MatrixXd generate(size_t count) {
+    Eigen::MatrixXd records(ResetStateBank::recordDim(layout(gcDim_, gvDim_)), count);
+    ResetState state;
+    raisim::Vec<3> footPosition;
+    for (size_t k = 0; k < count; k++) {
+      sampleInitialState(state, 1.);
+      raibo_->setGeneralizedCoordinate(gc_init_);
+      auto record = records.col(k);
+      record.head(gcDim_) = gc_init_;
+      record.segment(gcDim_, gvDim_) = gv_init_;
+      record.segment(gcDim_ + gvDim_, 3) = state.command;
+      for (int i = 0; i < 4; i++) {
+        raibo_->getFramePosition(footFrameIndicies_[i], footPosition);
+        record.segment(gcDim_ + gvDim_ + 3 + 3 * i, 3) = footPosition.e() - gc_init_.head(3);
+      }
+    }
+    return records;
+  }
+
+  int getGcDim() const { return gcDim_; }
+  int getGvDim() const { return gvDim_; }
+};
+
+int main(int argc, char *argv[]) {
+  RSFATAL_IF(argc < 4, "got "<<argc<<" arguments. "<<"This executable takes at least three arguments: 1. resource directory, 2. configuration file, 3. output file\n"
+      <<"options: --states <per ground type> --seed <n>")
+
+  std::string resourceDir(argv[1]), cfgFile(argv[2]), outputFile(argv[3]);
+  size_t states = 100000;
+  int seed = 0;
+
+  for (int i = 4; i < argc; i++) {
+    std::string arg(argv[i]);
+    RSFATAL_IF(i + 1 >= argc, "missing value for "<<arg)
+    std::string value(argv[++i]);
+    if (arg == "--states") states = std::stoul(value);
+    else if (arg == "--seed") seed = std::stoi(value);
+    else RSFATAL("unknown option "<<arg)
+  }
+  RSFATAL_IF(states == 0, "--states must be positive")
+
+  Yaml::Node config;
+  Yaml::Parse(config, readEnvironmentConfig(cfgFile));
+
+  /// section s holds the states of ground type s
+  std::vector<Eigen::MatrixXd> sections;
+  ResetStateBank::Header layout{};
+  for (int g = 0; g < 4; g++) {
+    BankGenerator generator(resourceDir, config, RandomHeightMapGenerator::GroundType(g), seed + g);
+    layout = BankGenerator::layout(generator.getGcDim(), generator.getGvDim());
+    sections.push_back(generator.generate(states));
+    std::cout << "[RAISIM_GYM] ground type " << g << ": " << states << " states" << std::endl;
+  }
+
+  ResetStateBank::save(outputFile, layout, sections);
+  std::cout << "[RAISIM_GYM] saved the reset state bank to " << outputFile << std::endl;
+  return 0;
+}
@@ -3,6 +3,7 @@ task_name = "rsg_raibo_rough_terrain"
 
 from ruamel.yaml import YAML, dump, RoundTripDumper
 from raisimGymTorch.env.bin.rsg_raibo_rough_terrain import RaisimGymRaiboRoughTerrain
+from raisimGymTorch.env.bin import rsg_raibo_rough_terrain
 from raisimGymTorch.env.bin.rsg_raibo_rough_terrain import NormalSampler
 from raisimGymTorch.env.RaisimGymVecEnv import RaisimGymVecEnv as VecEnv
 from raisimGymTorch.helper.raisim_gym_helper import ConfigurationSaver, load_param, tensorboard_launcher
@@ -38,10 +39,15 @@ cfg = YAML().load(open(task_path + "/cfg.yaml", 'r'))
 # create environment from the configuration file
 if mode == 'retrain':
     cfg['environment']['curriculum']['initial_factor'] = 1
-env = VecEnv(RaisimGymRaiboRoughTerrain(home_path + "/rsc", dump(cfg['environment'], Dumper=RoundTripDumper)), cfg['environment'])
+if cfg['environment'].get('num_shards', 1) > 1:
+    impl = rsg_raibo_rough_terrain.RaisimGymRaiboRoughTerrainSharded
+else:
+    impl = RaisimGymRaiboRoughTerrain
+env = VecEnv(impl(home_path + "/rsc", dump(cfg['environment'], Dumper=RoundTripDumper)), cfg['environment'])
 
 # shortcuts
 ob_dim = env.num_obs
+critic_ob_dim = env.num_critic_obs
 act_dim = env.num_acts
 
 # Training
@@ -55,13 +61,17 @@ actor = ppo_module.Actor(ppo_module.MLP(cfg['architecture']['policy_net'], nn.Le
                                                                            NormalSampler(act_dim),
                                                                            cfg['seed']),
                          device)
-critic = ppo_module.Critic(ppo_module.MLP(cfg['architecture']['value_net'], nn.LeakyReLU, ob_dim, 1),
+critic = ppo_module.Critic(ppo_module.MLP(cfg['architecture']['value_net'], nn.LeakyReLU, critic_ob_dim, 1),
                            device)
 
 saver = ConfigurationSaver(log_dir=home_path + "/raisimGymTorch/data/"+task_name,
                            save_items=[task_path + "/cfg.yaml", task_path + "/Environment.hpp", task_path + "/RaiboController.hpp"])
 tensorboard_launcher(saver.data_dir+"/..")  # press refresh (F5) after the first ppo update
 
+# the rollout storage keeps the 16-bit observations of compact_observation.type float16/int16
+compact_obs = env.compact_obs_type != 'float32'
+actor_obs_scale, critic_obs_scale = env.compact_obs_scale() if compact_obs else (None, None)
+
 ppo = PPO.PPO(actor=actor,
               critic=critic,
               num_envs=cfg['environment']['num_envs'],
@@ -75,6 +85,10 @@ ppo = PPO.PPO(actor=actor,
               log_dir=saver.data_dir,
               shuffle_batch=False,
               desired_kl=0.006,
+              share_critic_obs=not env.separate_critic_obs,
+              obs_dtype=env.compact_obs_type,
+              actor_obs_scale=actor_obs_scale,
+              critic_obs_scale=critic_obs_scale,
               )
 
 iteration_number = 0
@@ -82,12 +96,11 @@ iteration_number = 0
 if mode == 'retrain':
     iteration_number = load_param(weight_path, env, actor, critic, ppo.optimizer, saver.data_dir)
 
+total_dropped_episodes = 0
+
 for update in range(iteration_number, 1000000):
     start = time.time()
     env.reset()
-    reward_ll_sum = 0
-    done_sum = 0
-    average_dones = 0.
 
     if update % cfg['environment']['eval_every_n'] == 0:
         print("Visualizing and evaluating the current policy")
@@ -97,6 +110,7 @@ for update in range(iteration_number, 1000000):
             'critic_architecture_state_dict': critic.architecture.state_dict(),
             'optimizer_state_dict': ppo.optimizer.state_dict(),
         }, saver.data_dir+"/full_"+str(update)+'.pt')
+        actor.architecture.export_weights(saver.data_dir+"/actor_"+str(update)+'.bin')
 
         data_tags = env.get_step_data_tag()
         data_size = 0
@@ -121,23 +135,33 @@ for update in range(iteration_number, 1000000):
             ppo.writer.add_scalar(data_tags[data_id]+'/max', data_max[data_id], global_step=update)
 
         env.reset()
+        env.get_episode_stats()  # drop the evaluation episodes
         env.save_scaling(saver.data_dir, str(update))
 
     # actual training
     for step in range(n_steps):
         with torch.no_grad():
-            obs = env.observe(update < 10000)
+            obs, critic_obs = env.observe_with_critic(update < 10000)
+            stored_obs, stored_critic_obs = env.get_compact_observation() if compact_obs else (obs, critic_obs)
             action = ppo.act(obs)
             reward, dones = env.step(action)
-            ppo.step(value_obs=obs, rews=reward, dones=dones)
-            done_sum = done_sum + np.sum(dones)
-            reward_ll_sum = reward_ll_sum + np.sum(reward)
+            ppo.step(value_obs=stored_critic_obs, rews=reward, dones=dones, actor_obs=stored_obs)
+
+    # every reward of the rollout is in exactly one record: the finished episodes and, flushed, the ones in progress
+    episodes = env.get_episode_stats(flush=True)
+    finished = episodes['terminal'] > 0
+    # episodes that overflowed a queue are missing from the averages below
+    dropped_episodes = env.get_dropped_episode_count() - total_dropped_episodes
+    total_dropped_episodes += dropped_episodes
+    if dropped_episodes > 0:
+        print("[RAISIM_GYM] warning: " + str(dropped_episodes) + " episodes were dropped from the statistics of this "
+              "iteration. Increase episode_statistics.capacity")
 
     # take st step to get value obs
-    obs = env.observe(update < 10000)
-    ppo.update(actor_obs=obs, value_obs=obs, log_this_iteration=update % 10 == 0, update=update)
-    average_ll_performance = reward_ll_sum / total_steps
-    average_dones = done_sum / total_steps
+    obs, critic_obs = env.observe_with_critic(update < 10000)
+    ppo.update(actor_obs=obs, value_obs=critic_obs, log_this_iteration=update % 10 == 0, update=update)
+    average_ll_performance = episodes['return'].sum() / total_steps
+    average_dones = finished.sum() / total_steps
     actor.distribution.enforce_minimum_std((torch.ones(12)*(0.6*math.exp(-0.0002*update) + 0.4)).to(device))
     actor.update()
 
@@ -147,6 +171,10 @@ for update in range(iteration_number, 1000000):
     if update % 10 == 0:
         ppo.writer.add_scalar('Training/average_reward', average_ll_performance, global_step=update)
         ppo.writer.add_scalar('Training/dones', average_dones, global_step=update)
+        ppo.writer.add_scalar('Training/dropped_episodes', total_dropped_episodes, global_step=update)
+        if finished.any():
+            ppo.writer.add_scalar('Training/episode_return', episodes['return'][finished].mean(), global_step=update)
+            ppo.writer.add_scalar('Training/episode_length', episodes['length'][finished].mean(), global_step=update)
         ppo.writer.add_scalar('Training/learning_rate', ppo.learning_rate, global_step=update)
 
     end = time.time()
@@ -160,4 +188,10 @@ for update in range(iteration_number, 1000000):
     print('{:<40} {:>6}'.format("fps: ", '{:6.0f}'.format(total_steps / (end - start))))
     print('{:<40} {:>6}'.format("real time factor: ", '{:6.0f}'.format(total_steps / (end - start)
                                                                        * cfg['environment']['control_dt'])))
+    if update % 10 == 0:
+        profile = env.get_profile()  # empty unless compiled with --Profile
+        for phase, stat in sorted(profile.items(), key=lambda item: -item[1]['total']):
+            print('{:<40} {:>6}'.format(phase + " [ms] (total/p50/p99): ",
+                                        '{:9.1f} {:7.3f} {:7.3f}'.format(stat['total'] * 1e3, stat['p50'] * 1e3, stat['p99'] * 1e3)))
+        env.reset_profile()
     print('----------------------------------------------------\n')
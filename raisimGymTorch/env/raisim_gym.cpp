@@ -6,42 +6,164 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <pybind11/eigen.h>
+#include <pybind11/numpy.h>
 #include "Environment.hpp"
 #include "VectorizedEnvironment.hpp"
+#include "ShardedVectorizedEnvironment.hpp"
+#ifdef __linux__
+#include <dlfcn.h>
+#endif
 
 namespace py = pybind11;
 using namespace raisim;
 
 int THREAD_COUNT = 1;
 
+#ifdef __linux__
+/// the shard worker executable is built into the directory of this module
+static std::string shardWorkerExecutable() {
+  Dl_info info;
+  RSFATAL_IF(dladdr(reinterpret_cast<void *>(&shardWorkerExecutable), &info) == 0 || !info.dli_fname,
+             "cannot locate the python module")
+  std::string path(info.dli_fname);
+  path.erase(path.find_last_of('/') + 1);
+  return path + RSG_MAKE_STR(RAISIMGYM_TORCH_ENV_NAME) "_shard_worker";
+}
+#endif
+
 PYBIND11_MODULE(RAISIMGYM_TORCH_ENV_NAME, m) {
   py::class_<VectorizedEnvironment<ENVIRONMENT>>(m, "RaisimGymRaiboRoughTerrain")
     .def(py::init<std::string, std::string>())
     .def("init", &VectorizedEnvironment<ENVIRONMENT>::init)
     .def("reset", &VectorizedEnvironment<ENVIRONMENT>::reset)
     .def("observe", &VectorizedEnvironment<ENVIRONMENT>::observe)
+    .def("observeWithCritic", &VectorizedEnvironment<ENVIRONMENT>::observeWithCritic)
     .def("step", &VectorizedEnvironment<ENVIRONMENT>::step)
     .def("step_visualize", &VectorizedEnvironment<ENVIRONMENT>::step_visualize)
+    .def("asyncReset", &VectorizedEnvironment<ENVIRONMENT>::asyncReset, py::call_guard<py::gil_scoped_release>())
+    .def("recv", &VectorizedEnvironment<ENVIRONMENT>::recv, py::call_guard<py::gil_scoped_release>())
+    .def("send", &VectorizedEnvironment<ENVIRONMENT>::send, py::call_guard<py::gil_scoped_release>())
+    .def("getNumOfGroups", &VectorizedEnvironment<ENVIRONMENT>::getNumOfGroups)
+    .def("getGroupSize", &VectorizedEnvironment<ENVIRONMENT>::getGroupSize)
     .def("setSeed", &VectorizedEnvironment<ENVIRONMENT>::setSeed)
     .def("close", &VectorizedEnvironment<ENVIRONMENT>::close)
     .def("isTerminalState", &VectorizedEnvironment<ENVIRONMENT>::isTerminalState)
     .def("setSimulationTimeStep", &VectorizedEnvironment<ENVIRONMENT>::setSimulationTimeStep)
     .def("setControlTimeStep", &VectorizedEnvironment<ENVIRONMENT>::setControlTimeStep)
     .def("getObDim", &VectorizedEnvironment<ENVIRONMENT>::getObDim)
+    .def("getCriticObDim", &VectorizedEnvironment<ENVIRONMENT>::getCriticObDim)
+    .def("hasSeparateCriticObservation", &VectorizedEnvironment<ENVIRONMENT>::hasSeparateCriticObservation)
     .def("getActionDim", &VectorizedEnvironment<ENVIRONMENT>::getActionDim)
     .def("getNumOfEnvs", &VectorizedEnvironment<ENVIRONMENT>::getNumOfEnvs)
     .def("turnOnVisualization", &VectorizedEnvironment<ENVIRONMENT>::turnOnVisualization)
     .def("turnOffVisualization", &VectorizedEnvironment<ENVIRONMENT>::turnOffVisualization)
     .def("stopRecordingVideo", &VectorizedEnvironment<ENVIRONMENT>::stopRecordingVideo)
     .def("startRecordingVideo", &VectorizedEnvironment<ENVIRONMENT>::startRecordingVideo)
+    .def("startRecordingTrajectory", &VectorizedEnvironment<ENVIRONMENT>::startRecordingTrajectory, py::arg("fileName"), py::arg("id") = 0)
+    .def("stopRecordingTrajectory", &VectorizedEnvironment<ENVIRONMENT>::stopRecordingTrajectory, py::arg("id") = 0)
+    .def("startLogging", &VectorizedEnvironment<ENVIRONMENT>::startLogging, py::arg("fileName"), py::arg("envIds"), py::arg("chunkSteps") = 256)
+    .def("stopLogging", &VectorizedEnvironment<ENVIRONMENT>::stopLogging)
     .def("curriculumUpdate", &VectorizedEnvironment<ENVIRONMENT>::curriculumUpdate)
     .def("getStepDataTag", &VectorizedEnvironment<ENVIRONMENT>::getStepDataTag)
     .def("getStepData", &VectorizedEnvironment<ENVIRONMENT>::getStepData)
+    .def("getEpisodeStats", &VectorizedEnvironment<ENVIRONMENT>::getEpisodeStats, py::arg("flush") = false,
+         py::arg("maxRecords") = std::numeric_limits<int>::max())
+    .def("getEpisodeStatsTag", &VectorizedEnvironment<ENVIRONMENT>::getEpisodeStatsTag)
+    .def("getDroppedEpisodeCount", &VectorizedEnvironment<ENVIRONMENT>::getDroppedEpisodeCount)
     .def("setCommand", &VectorizedEnvironment<ENVIRONMENT>::setCommand)
     .def("moveControllerCursor", &VectorizedEnvironment<ENVIRONMENT>::moveControllerCursor)
     .def("getState", &VectorizedEnvironment<ENVIRONMENT>::getState)
+    .def("getGcDim", &VectorizedEnvironment<ENVIRONMENT>::getGcDim)
+    .def("getGvDim", &VectorizedEnvironment<ENVIRONMENT>::getGvDim)
+    .def("getStates", &VectorizedEnvironment<ENVIRONMENT>::getStates)
+    .def("setStates", &VectorizedEnvironment<ENVIRONMENT>::setStates)
+    .def("getFrameStackBuffer", [](py::object self) {
+      /// a view of the [envs x 2 frames x obDim] ring that keeps the environment alive
+      auto &frameStack = self.cast<VectorizedEnvironment<ENVIRONMENT> &>().getFrameStack();
+      RSFATAL_IF(!frameStack.enabled(), "frame_stack.frames is 0")
+      return py::array_t<float>({frameStack.envs(), frameStack.slots(), frameStack.obDim()}, frameStack.data(), self);
+    })
+    .def("getFrameStackWindow", &VectorizedEnvironment<ENVIRONMENT>::getFrameStackWindow)
+    .def("getCompactObservationType", &VectorizedEnvironment<ENVIRONMENT>::getCompactObservationType)
+    .def("getCompactObservationBuffer", [](py::object self, bool critic) {
+      /// a view of the [envs x obDim] 16-bit buffer that keeps the environment alive
+      auto &env = self.cast<VectorizedEnvironment<ENVIRONMENT> &>();
+      auto &compact = critic ? env.getCompactCriticObservation() : env.getCompactObservation();
+      RSFATAL_IF(!compact.enabled(), "compact_observation.type is float32 or the critic observes the actor observation")
+      return py::array_t<int16_t>({compact.envs(), compact.obDim()}, compact.data(), self);
+    }, py::arg("critic") = false)
+    .def("getCompactObScale", &VectorizedEnvironment<ENVIRONMENT>::getCompactObScale)
+    .def("getCompactCriticObScale", &VectorizedEnvironment<ENVIRONMENT>::getCompactCriticObScale)
     .def("getObStatistics", &VectorizedEnvironment<ENVIRONMENT>::getObStatistics)
-    .def("setObStatistics", &VectorizedEnvironment<ENVIRONMENT>::setObStatistics);
+    .def("setObStatistics", &VectorizedEnvironment<ENVIRONMENT>::setObStatistics)
+    .def("saveObStatistics", &VectorizedEnvironment<ENVIRONMENT>::saveObStatistics)
+    .def("loadObStatistics", &VectorizedEnvironment<ENVIRONMENT>::loadObStatistics)
+    .def("getCriticObStatistics", &VectorizedEnvironment<ENVIRONMENT>::getCriticObStatistics)
+    .def("setCriticObStatistics", &VectorizedEnvironment<ENVIRONMENT>::setCriticObStatistics)
+    .def("getProfile", &VectorizedEnvironment<ENVIRONMENT>::getProfile)
+    .def("resetProfile", &VectorizedEnvironment<ENVIRONMENT>::resetProfile)
+    .def("getPlacementReport", &VectorizedEnvironment<ENVIRONMENT>::getPlacementReport)
+    .def("startTracing", &VectorizedEnvironment<ENVIRONMENT>::startTracing, py::arg("eventsPerThread") = 1 << 16)
+    .def("stopTracing", &VectorizedEnvironment<ENVIRONMENT>::stopTracing)
+    .def("dumpTrace", &VectorizedEnvironment<ENVIRONMENT>::dumpTrace)
+    .def("getSnapshots", [](VectorizedEnvironment<ENVIRONMENT> &self) {
+      py::list blobs;
+      for (auto &blob: self.getSnapshots())
+        blobs.append(py::bytes(blob));
+      return blobs;
+    })
+    .def("setSnapshots", &VectorizedEnvironment<ENVIRONMENT>::setSnapshots)
+    .def("getSnapshot", [](VectorizedEnvironment<ENVIRONMENT> &self, int id) { return py::bytes(self.getSnapshot(id)); })
+    .def("setSnapshot", &VectorizedEnvironment<ENVIRONMENT>::setSnapshot);
+
+#ifdef __linux__
+  using ShardedEnvironment = ShardedVectorizedEnvironment<ENVIRONMENT>;
+  py::class_<ShardedEnvironment>(m, "RaisimGymRaiboRoughTerrainSharded")
+    .def(py::init([](std::string resourceDir, std::string cfg) {
+      return new ShardedEnvironment(std::move(resourceDir), std::move(cfg), shardWorkerExecutable()); }))
+    .def("init", &ShardedEnvironment::init)
+    .def("reset", &ShardedEnvironment::reset)
+    .def("observe", &ShardedEnvironment::observe)
+    .def("step", &ShardedEnvironment::step)
+    .def("step_visualize", &ShardedEnvironment::step_visualize)
+    .def("setSeed", &ShardedEnvironment::setSeed)
+    .def("close", &ShardedEnvironment::close)
+    .def("isTerminalState", &ShardedEnvironment::isTerminalState)
+    .def("setSimulationTimeStep", &ShardedEnvironment::setSimulationTimeStep)
+    .def("setControlTimeStep", &ShardedEnvironment::setControlTimeStep)
+    .def("getObDim", &ShardedEnvironment::getObDim)
+    .def("getCriticObDim", &ShardedEnvironment::getCriticObDim)
+    .def("hasSeparateCriticObservation", &ShardedEnvironment::hasSeparateCriticObservation)
+    .def("getCompactObservationType", &ShardedEnvironment::getCompactObservationType)
+    .def("getActionDim", &ShardedEnvironment::getActionDim)
+    .def("getNumOfEnvs", &ShardedEnvironment::getNumOfEnvs)
+    .def("getNumOfShards", &ShardedEnvironment::getNumOfShards)
+    .def("turnOnVisualization", &ShardedEnvironment::turnOnVisualization)
+    .def("turnOffVisualization", &ShardedEnvironment::turnOffVisualization)
+    .def("stopRecordingVideo", &ShardedEnvironment::stopRecordingVideo)
+    .def("startRecordingVideo", &ShardedEnvironment::startRecordingVideo)
+    .def("startRecordingTrajectory", &ShardedEnvironment::startRecordingTrajectory, py::arg("fileName"), py::arg("id") = 0)
+    .def("stopRecordingTrajectory", &ShardedEnvironment::stopRecordingTrajectory, py::arg("id") = 0)
+    .def("startLogging", &ShardedEnvironment::startLogging, py::arg("fileName"), py::arg("envIds"), py::arg("chunkSteps") = 256)
+    .def("stopLogging", &ShardedEnvironment::stopLogging)
+    .def("curriculumUpdate", &ShardedEnvironment::curriculumUpdate)
+    .def("getStepDataTag", &ShardedEnvironment::getStepDataTag)
+    .def("getStepData", &ShardedEnvironment::getStepData)
+    .def("getEpisodeStats", &ShardedEnvironment::getEpisodeStats, py::arg("flush") = false)
+    .def("getEpisodeStatsTag", &ShardedEnvironment::getEpisodeStatsTag)
+    .def("getDroppedEpisodeCount", &ShardedEnvironment::getDroppedEpisodeCount)
+    .def("setCommand", &ShardedEnvironment::setCommand)
+    .def("moveControllerCursor", &ShardedEnvironment::moveControllerCursor)
+    .def("getState", &ShardedEnvironment::getState)
+    .def("getStates", &ShardedEnvironment::getStates)
+    .def("setStates", &ShardedEnvironment::setStates)
+    .def("getObStatistics", &ShardedEnvironment::getObStatistics)
+    .def("setObStatistics", &ShardedEnvironment::setObStatistics)
+    .def("saveObStatistics", &ShardedEnvironment::saveObStatistics)
+    .def("loadObStatistics", &ShardedEnvironment::loadObStatistics)
+    .def("getProfile", &ShardedEnvironment::getProfile)
+    .def("resetProfile", &ShardedEnvironment::resetProfile);
+#endif
 
   py::class_<NormalSampler>(m, "NormalSampler")
       .def(py::init<int>(), py::arg("dim"))
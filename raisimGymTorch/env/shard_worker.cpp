@@ -0,0 +1,25 @@
+//----------------------------//
+// This file is part of RaiSim//
+// Copyright 2020, RaiSim Tech//
+//----------------------------//
+
+#include "Environment.hpp"
+#include "ShardedVectorizedEnvironment.hpp"
+#include <sys/prctl.h>
+
+int THREAD_COUNT = 1;
+
+using namespace raisim;
+
+/// worker process of a ShardedVectorizedEnvironment. Started by the trainer, not meant to be run by hand
+int main(int argc, char *argv[]) {
+  RSFATAL_IF(argc != 5, "got "<<argc<<" arguments. "<<"This executable takes four arguments: 1. resource directory, "
+      <<"2. shared memory segment, 3. shard index, 4. trainer pid")
+
+  /// the worker dies with the trainer
+  prctl(PR_SET_PDEATHSIG, SIGKILL);
+  if (getppid() != std::stoi(argv[4]))
+    return 1;
+
+  return ShardedVectorizedEnvironment<ENVIRONMENT>::runWorker(argv[1], argv[2], std::stoi(argv[3]));
+}
@@ -39,9 +39,13 @@ def load_param(weight_path, env, actor, critic, optimizer, data_dir):
     iteration_number = weight_path.rsplit('/', 1)[1].split('_', 1)[1].rsplit('.', 1)[0]
     weight_dir = weight_path.rsplit('/', 1)[0] + '/'
 
-    mean_csv_path = weight_dir + 'mean' + iteration_number + '.csv'
-    var_csv_path = weight_dir + 'var' + iteration_number + '.csv'
-    items_to_save = [weight_path, mean_csv_path, var_csv_path, weight_dir + "cfg.yaml", weight_dir + "Environment.hpp"]
+    # the normalization checkpoint, or the mean/var CSV files of runs that predate it (see env.load_scaling)
+    scaling_path = weight_dir + 'scaling' + iteration_number + '.bin'
+    if os.path.exists(scaling_path):
+        scaling_items = [scaling_path]
+    else:
+        scaling_items = [weight_dir + 'mean' + iteration_number + '.csv', weight_dir + 'var' + iteration_number + '.csv']
+    items_to_save = [weight_path] + scaling_items + [weight_dir + "cfg.yaml", weight_dir + "Environment.hpp"]
 
     if items_to_save is not None:
         pretrained_data_dir = data_dir + '/pretrained_' + weight_path.rsplit('/', 1)[0].rsplit('/', 1)[1]
@@ -59,3 +63,97 @@ def load_param(weight_path, env, actor, critic, optimizer, data_dir):
     critic.architecture.load_state_dict(checkpoint['critic_architecture_state_dict'])
     optimizer.load_state_dict(checkpoint['optimizer_state_dict'])
     return int(iteration_number)
+
+
+def load_reset_state_bank(file_name):
+    """reads a reset state bank written by <env>_reset_bank.
+    returns a list with one dict per section (ground type) of memory-mapped arrays
+    gc [n x gcDim], gv [n x gvDim] (curriculum factor 1), command [n x commandDim] and foot_offsets [n x feet x 3]"""
+    import numpy as np
+    header = np.fromfile(file_name, dtype=np.uint32, count=8)
+    magic, version, gc_dim, gv_dim, command_dim, foot_count, section_count, _ = [int(x) for x in header]
+    if magic != 0x42524752:
+        raise Exception(file_name + " is not a reset state bank")
+    if version != 1:
+        raise Exception("reset state bank version " + str(version) + " is not supported")
+
+    record_dim = gc_dim + gv_dim + command_dim + 3 * foot_count
+    table = np.fromfile(file_name, dtype=np.uint64, count=2 * section_count, offset=32).reshape(section_count, 2)
+    sections = []
+    for offset, count in table:
+        records = np.memmap(file_name, dtype=np.float64, mode='r', offset=int(offset), shape=(int(count), record_dim))
+        sections.append({'gc': records[:, :gc_dim],
+                         'gv': records[:, gc_dim:gc_dim + gv_dim],
+                         'command': records[:, gc_dim + gv_dim:gc_dim + gv_dim + command_dim],
+                         'foot_offsets': records[:, gc_dim + gv_dim + command_dim:].reshape(int(count), foot_count, 3)})
+    return sections
+
+
+def load_trajectory(file_name):
+    """reads a trajectory written by start_trajectory_recording.
+    returns a dict with control_dt, step [n] and gc [n x gcDim] of every frame, episode_start [episodes] (the index of
+    the first frame of every episode) and terrains, a list of (first frame index, dict of x_samples, y_samples, x_size,
+    y_size, center_x, center_y and heights [y_samples x x_samples])"""
+    import numpy as np
+    data = np.fromfile(file_name, dtype=np.uint8)
+    magic, version, gc_dim, _ = data[:16].view(np.uint32)
+    if magic != 0x52544752:
+        raise Exception(file_name + " is not a trajectory file")
+    if version != 1:
+        raise Exception("trajectory version " + str(version) + " is not supported")
+    control_dt = float(data[16:24].view(np.float64)[0])
+
+    steps, frames, episode_start, terrains = [], [], [], []
+    offset = 24
+    while offset + 8 <= len(data):
+        record_type, size = (int(x) for x in data[offset:offset + 8].view(np.uint32))
+        payload = data[offset + 8:offset + 8 + size]
+        offset += 8 + size
+        if len(payload) < size:
+            break  # the recorder was not stopped
+        if record_type == 1:
+            x_samples, y_samples = (int(x) for x in payload[:8].view(np.int32))
+            x_size, y_size, center_x, center_y = payload[8:40].view(np.float64)
+            terrains.append((len(frames), {'x_samples': x_samples, 'y_samples': y_samples, 'x_size': x_size,
+                                           'y_size': y_size, 'center_x': center_x, 'center_y': center_y,
+                                           'heights': payload[40:].view(np.float32).reshape(y_samples, x_samples)}))
+        elif record_type == 2:
+            episode_start.append(len(frames))
+        elif record_type == 3:
+            steps.append(int(payload[:8].view(np.uint64)[0]))
+            frames.append(payload[8:].view(np.float32))
+
+    return {'control_dt': control_dt,
+            'step': np.array(steps, dtype=np.uint64),
+            'gc': np.array(frames, dtype=np.float32).reshape(len(frames), int(gc_dim)),
+            'episode_start': np.array(episode_start, dtype=np.int64),
+            'terrains': terrains}
+
+
+def load_columnar_log(file_name):
+    """reads a step log written by start_logging.
+    returns a dict with env_ids [envs] and one array [steps x envs x width] per column (gc, gv, action, reward, done,
+    contact). The columns of every chunk are memory-mapped and concatenated"""
+    import numpy as np
+    header = np.fromfile(file_name, dtype=np.uint32, count=6)
+    magic, version, column_count, env_count, chunk_steps, _ = [int(x) for x in header]
+    if magic != 0x4c434752:
+        raise Exception(file_name + " is not a columnar log")
+    if version != 1:
+        raise Exception("columnar log version " + str(version) + " is not supported")
+    data_offset, chunk_bytes, steps = [int(x) for x in np.fromfile(file_name, dtype=np.uint64, count=3, offset=24)]
+    column_type = np.dtype([('name', 'S48'), ('type', np.uint32), ('width', np.uint32), ('offset', np.uint64)])
+    columns = np.fromfile(file_name, dtype=column_type, count=column_count, offset=48)
+    env_ids = np.fromfile(file_name, dtype=np.uint32, count=env_count, offset=48 + column_type.itemsize * column_count)
+
+    log = {'env_ids': env_ids}
+    for column in columns:
+        dtype = [np.float32, np.float64, np.uint8][int(column['type'])]
+        width = int(column['width'])
+        blocks = []
+        for chunk in range((steps + chunk_steps - 1) // chunk_steps):
+            count = min(chunk_steps, steps - chunk * chunk_steps)
+            blocks.append(np.memmap(file_name, dtype=dtype, mode='r', shape=(count, env_count, width),
+                                    offset=data_offset + chunk * chunk_bytes + int(column['offset'])))
+        log[column['name'].decode()] = np.concatenate(blocks) if blocks else np.zeros([0, env_count, width], dtype=dtype)
+    return log
@@ -10,6 +10,7 @@ from distutils.core import setup
 
 __CMAKE_PREFIX_PATH__ = None
 __DEBUG__ = False
+__PROFILE__ = False
 
 if "--CMAKE_PREFIX_PATH" in sys.argv:
     index = sys.argv.index('--CMAKE_PREFIX_PATH')
@@ -22,6 +23,10 @@ if "--Debug" in sys.argv:
     sys.argv.remove("--Debug")
     __DEBUG__ = True
 
+if "--Profile" in sys.argv:
+    sys.argv.remove("--Profile")
+    __PROFILE__ = True
+
 class CMakeExtension(Extension):
     def __init__(self, name, sourcedir=''):
         Extension.__init__(self, name, sources=[])
@@ -46,6 +51,9 @@ class CMakeBuild(build_ext):
         if __CMAKE_PREFIX_PATH__ is not None:
             cmake_args.append('-DCMAKE_PREFIX_PATH=' + __CMAKE_PREFIX_PATH__)
 
+        if __PROFILE__:
+            cmake_args.append('-DRAISIMGYM_PROFILE=ON')
+
         cfg = 'Debug' if __DEBUG__ else 'Release'
         build_args = ['--config', cfg]
 